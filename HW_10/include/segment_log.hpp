@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace async {
+
+// Appends records to a series of files named <prefix><time>_<n>.log. A new
+// segment starts once the current one would grow past max_bytes or has been
+// open for max_age; a record never spans two segments. Records are written
+// in batches with one writev() each, and with sync set every batch is
+// followed by one fdatasync().
+class segment_log {
+    std::string prefix_;
+    std::size_t max_bytes_;
+    std::chrono::steady_clock::duration max_age_;
+    bool sync_;
+    std::size_t sequence_ = 0;
+    std::size_t bytes_ = 0;
+    std::chrono::steady_clock::time_point opened_;
+#if defined(_WIN32)
+    std::ofstream file_;
+
+    [[nodiscard]] bool is_open() const {
+        return file_.is_open();
+    }
+#else
+    int descriptor_ = -1;
+
+    [[nodiscard]] bool is_open() const {
+        return descriptor_ >= 0;
+    }
+#endif
+
+    void open() {
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        const std::string name = prefix_ + std::to_string(seconds) + "_"
+            + std::to_string(sequence_++) + ".log";
+
+#if defined(_WIN32)
+        file_.open(name, std::ios::binary | std::ios::app);
+#else
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg,hicpp-vararg)
+        descriptor_ = ::open(name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+            S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+#endif
+        bytes_ = 0;
+        opened_ = std::chrono::steady_clock::now();
+    }
+
+    void close() {
+#if defined(_WIN32)
+        file_.close();
+#else
+        if (is_open()) {
+            ::close(descriptor_);
+            descriptor_ = -1;
+        }
+#endif
+    }
+
+    void write(std::vector<std::string>::const_iterator first,
+        std::vector<std::string>::const_iterator last) {
+#if defined(_WIN32)
+        for (; first != last; ++first) {
+            file_.write(first->data(), static_cast<std::streamsize>(first->size()));
+        }
+
+        file_.flush();
+#else
+        std::vector<iovec> buffers;
+        buffers.reserve(static_cast<std::size_t>(last - first));
+        for (; first != last; ++first) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+            buffers.push_back({const_cast<char*>(first->data()), first->size()});
+        }
+
+        std::size_t done = 0;
+        while (done < buffers.size()) {
+            const auto count = static_cast<int>(std::min<std::size_t>(
+                buffers.size() - done, IOV_MAX));
+            const ssize_t written = ::writev(descriptor_, &buffers.at(done), count);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                return;
+            }
+
+            // Skips the buffers written in full and trims a partially written one.
+            auto left = static_cast<std::size_t>(written);
+            while (done < buffers.size() && left >= buffers.at(done).iov_len) {
+                left -= buffers.at(done).iov_len;
+                ++done;
+            }
+
+            if (left > 0) {
+                auto& partial = buffers.at(done);
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                partial.iov_base = static_cast<char*>(partial.iov_base) + left;
+                partial.iov_len -= left;
+            }
+        }
+
+        if (sync_) {
+            ::fdatasync(descriptor_);
+        }
+#endif
+    }
+public:
+    segment_log(std::string prefix, std::size_t max_bytes,
+        std::chrono::steady_clock::duration max_age, bool sync) :
+        prefix_(std::move(prefix)), max_bytes_(max_bytes), max_age_(max_age),
+        sync_(sync) {}
+
+    segment_log(const segment_log&) = delete;
+    segment_log(segment_log&&) = delete;
+    segment_log& operator=(const segment_log&) = delete;
+    segment_log& operator=(segment_log&&) = delete;
+
+    ~segment_log() {
+        close();
+    }
+
+    void append(const std::vector<std::string>& records) {
+        auto first = records.begin();
+        std::size_t batch_bytes = 0;
+        bool old = std::chrono::steady_clock::now() - opened_ >= max_age_;
+
+        for (auto record = records.begin(); record != records.end(); ++record) {
+            const bool full = bytes_ + batch_bytes + record->size() > max_bytes_;
+
+            if (!is_open() || ((full || old) && bytes_ + batch_bytes > 0)) {
+                if (is_open()) {
+                    write(first, record);
+                    close();
+                }
+
+                open();
+                first = record;
+                batch_bytes = 0;
+                old = false;
+            }
+
+            batch_bytes += record->size();
+        }
+
+        if (is_open() && first != records.end()) {
+            write(first, records.end());
+            bytes_ += batch_bytes;
+        }
+    }
+};
+
+} // namespace async
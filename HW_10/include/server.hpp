@@ -16,6 +16,11 @@ namespace async
         Server(
             std::uint16_t port,
             std::size_t   bulk_size);
+        // Runs the network handlers on thread_count threads.
+        Server(
+            std::uint16_t port,
+            std::size_t   bulk_size,
+            std::size_t   thread_count);
 
         Server(const Server&) = delete;
         Server& operator=(const Server&) = delete;
@@ -1,8 +1,12 @@
 #ifndef SERVER_P_HPP
 #define SERVER_P_HPP
 
+#include <array>
+#include <chrono>
 #include <iostream>
+#include <mutex>
 
+#include <async_config.h>
 #include <server.hpp>
 #include <wrapper_boost_asio.hpp>
 
@@ -14,20 +18,27 @@ namespace async
         ServerImpl(
             std::unique_ptr<boost::asio::io_context> io_context,
             const std::uint16_t                      port,
-            const std::size_t                        bulk_size)
+            const std::size_t                        bulk_size,
+            const std::size_t                        thread_count)
             :
             io_context_(std::move(io_context)),
             acceptor_(*io_context_,
                 boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)),
-            bulk_size_(bulk_size)
+            bulk_size_(bulk_size),
+            thread_count_(std::max<std::size_t>(thread_count, 1))
         {
             std::cout << "Server started on port " << port << " with bulk size "
                 << bulk_size << '\n';
         }
 
+        // Every session gets a strand of its own, so the handlers of one
+        // connection never run concurrently while different connections are
+        // served by all threads of the pool.
         void start_accept()
         {
             acceptor_.async_accept(
+                boost::asio::strand<boost::asio::io_context::executor_type>(
+                    io_context_->get_executor()),
                 [this](
                     const boost::system::error_code& error,
                     boost::asio::ip::tcp::socket     socket)
@@ -37,7 +48,11 @@ namespace async
                         auto new_session = std::make_shared<Session>(&socket, *this,
                             bulk_size_);
 
-                        sessions_.emplace_back(new_session);
+                        {
+                            const std::scoped_lock<std::mutex> lock(sessions_mutex_);
+                            sessions_.emplace_back(new_session);
+                        }
+
                         new_session->start();
                     }
                     else
@@ -51,6 +66,7 @@ namespace async
 
         void remove_session(const std::shared_ptr<Session>& session)
         {
+            const std::scoped_lock<std::mutex> lock(sessions_mutex_);
             std::erase(sessions_, session);
         }
 
@@ -59,11 +75,14 @@ namespace async
         std::unique_ptr<boost::asio::io_context> io_context_;
         boost::asio::ip::tcp::acceptor acceptor_;
         std::size_t bulk_size_;
+        std::size_t thread_count_;
+        std::mutex sessions_mutex_;
         std::vector<std::shared_ptr<Session>> sessions_;
     };
 
     class SessionImpl
     {
+        static constexpr std::size_t READ_BUFFER_SIZE = 16 * 1024;
     public:
         SessionImpl(
             boost::asio::ip::tcp::socket& socket,
@@ -72,10 +91,10 @@ namespace async
             Session&                      session)
             :
             socket_(std::move(socket)),
+            pause_timer_(socket_.get_executor()),
             bulk_size_(bulk_size),
             server_(server),
-            session_(session),
-            buffer_(std::make_unique<boost::asio::streambuf>()) {}
+            session_(session) {}
 
         ~SessionImpl()
         {
@@ -93,7 +112,32 @@ namespace async
         void start()
         {
             handle_ = connect(bulk_size_);
-            boost::asio::async_read_until(socket_, *buffer_, '\n',
+            read_next();
+        }
+
+        // Leaves the socket unread while the output writers are behind, so a
+        // fast client is held back by TCP flow control instead of filling
+        // the output queues.
+        void read_next()
+        {
+            constexpr std::chrono::milliseconds PAUSE_CHECK_INTERVAL{5};
+
+            if (output_throttled())
+            {
+                pause_timer_.expires_after(PAUSE_CHECK_INTERVAL);
+                pause_timer_.async_wait(
+                    [this](const boost::system::error_code& error)
+                    {
+                        if (!error)
+                        {
+                            read_next();
+                        }
+                    });
+
+                return;
+            }
+
+            socket_.async_read_some(boost::asio::buffer(buffer_),
                 [this](
                     const boost::system::error_code& error,
                     const std::size_t                bytes_transferred)
@@ -102,45 +146,20 @@ namespace async
                 });
         }
 
+        // Hands whatever arrived to receive() as is: the handle keeps a line
+        // cut by the end of the buffer until the rest of it comes, and
+        // disconnect() emits an unterminated last line.
         void handle_read(
             const boost::system::error_code& error,
             const std::size_t                bytes_transferred)
         {
             if (!error)
             {
-                std::string data;
-
-                data.resize(bytes_transferred);
-                boost::asio::buffer_copy(boost::asio::buffer(data), buffer_->data(),
-                    bytes_transferred);
-                buffer_->consume(bytes_transferred);
-                receive(handle_, data.c_str(), data.size());
-                boost::asio::async_read_until(socket_, *buffer_, '\n',
-                    [this](
-                        const boost::system::error_code& new_error,
-                        const std::size_t                new_bytes_transferred)
-                    {
-                        handle_read(new_error, new_bytes_transferred);
-                    });
+                receive(handle_, buffer_.data(), bytes_transferred);
+                read_next();
             }
             else if (error == boost::asio::error::eof)
             {
-                if (buffer_->size() > 0)
-                {
-                    std::string data;
-
-                    data.resize(buffer_->size());
-                    boost::asio::buffer_copy(boost::asio::buffer(data), buffer_->data(),
-                        buffer_->size());
-                    buffer_->consume(buffer_->size());
-                    if (!data.empty() && data.back() != '\n')
-                    {
-                        data += '\n';
-                    }
-
-                    receive(handle_, data.c_str(), data.size());
-                }
-
                 if (handle_ != nullptr)
                 {
                     disconnect(handle_);
@@ -158,11 +177,12 @@ namespace async
 
     private:
         boost::asio::ip::tcp::socket socket_;
+        boost::asio::steady_timer pause_timer_;
         std::size_t bulk_size_;
         handle_t handle_{nullptr};
         ServerImpl& server_;
         Session& session_;
-        std::unique_ptr<boost::asio::streambuf> buffer_;
+        std::array<char, READ_BUFFER_SIZE> buffer_{};
     };
 } // namespace async
 
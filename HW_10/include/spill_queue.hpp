@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace async {
+
+// A first-in first-out queue of records kept in a file instead of memory.
+// Every record follows a line holding its length; the file is truncated
+// whenever the last record has been read back, and removed on destruction.
+class spill_queue {
+    std::string path_;
+    std::fstream file_;
+    std::streamoff read_offset_ = 0;
+    std::size_t size_ = 0;
+
+    void reset() {
+        file_.close();
+        file_.open(path_,
+            std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        read_offset_ = 0;
+        size_ = 0;
+    }
+public:
+    explicit spill_queue(std::string path) : path_(std::move(path)) {
+        reset();
+    }
+
+    spill_queue(const spill_queue&) = delete;
+    spill_queue(spill_queue&&) = delete;
+    spill_queue& operator=(const spill_queue&) = delete;
+    spill_queue& operator=(spill_queue&&) = delete;
+
+    ~spill_queue() {
+        file_.close();
+        std::remove(path_.c_str());
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return size_;
+    }
+
+    // Returns false when the record could not be written.
+    bool push(std::string_view record) {
+        file_.clear();
+        file_.seekp(0, std::ios::end);
+        file_ << record.size() << '\n';
+        file_.write(record.data(), static_cast<std::streamsize>(record.size()));
+        if (!file_) {
+            return false;
+        }
+
+        ++size_;
+
+        return true;
+    }
+
+    // Returns false when the queue is empty or the next record cannot be read
+    // back; in the latter case every queued record is discarded and added to
+    // lost.
+    bool pop(std::string& record, std::size_t& lost) {
+        if (size_ == 0) {
+            return false;
+        }
+
+        std::size_t length = 0;
+        file_.clear();
+        file_.seekg(read_offset_);
+        file_ >> length;
+        file_.ignore(1);
+        record.resize(length);
+        file_.read(record.data(), static_cast<std::streamsize>(length));
+        if (!file_) {
+            lost += size_;
+            reset();
+
+            return false;
+        }
+
+        read_offset_ = file_.tellg();
+        if (--size_ == 0) {
+            reset();
+        }
+
+        return true;
+    }
+};
+
+} // namespace async
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace async {
+
+// Runs delayed callbacks for every connection on one thread. Time advances in
+// ticks; a callback lands in the slot of the tick it is due on and waits
+// there for as many turns of the wheel as its delay spans. Callbacks run late
+// by at most one tick and never early.
+class timer_wheel {
+    static constexpr std::size_t SLOT_COUNT = 256;
+
+    struct entry {
+        std::size_t turns;
+        std::function<void()> callback;
+    };
+
+    std::chrono::steady_clock::duration tick_;
+    std::array<std::vector<entry>, SLOT_COUNT> slots_;
+    std::size_t cursor_ = 0;
+    std::size_t pending_ = 0;
+    std::chrono::steady_clock::time_point next_tick_;
+    bool stopping_ = false;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread thread_;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::vector<std::function<void()>> due;
+
+        while (!stopping_) {
+            if (pending_ == 0) {
+                wake_.wait(lock, [this] { return stopping_ || pending_ > 0; });
+                continue;
+            }
+
+            if (wake_.wait_until(lock, next_tick_, [this] { return stopping_; })) {
+                break;
+            }
+
+            cursor_ = (cursor_ + 1) % SLOT_COUNT;
+            next_tick_ += tick_;
+
+            auto& slot = slots_.at(cursor_);
+            const auto waiting = std::partition(slot.begin(), slot.end(),
+                [](const entry& item) noexcept { return item.turns > 0; });
+            for (auto item = waiting; item != slot.end(); ++item) {
+                due.emplace_back(std::move(item->callback));
+            }
+
+            slot.erase(waiting, slot.end());
+            for (auto& item : slot) {
+                --item.turns;
+            }
+
+            pending_ -= due.size();
+            lock.unlock();
+            for (const auto& callback : due) {
+                callback();
+            }
+
+            due.clear();
+            lock.lock();
+        }
+    }
+public:
+    explicit timer_wheel(std::chrono::steady_clock::duration tick) :
+        tick_(tick), thread_([this] { run(); }) {}
+
+    timer_wheel(const timer_wheel&) = delete;
+    timer_wheel(timer_wheel&&) = delete;
+    timer_wheel& operator=(const timer_wheel&) = delete;
+    timer_wheel& operator=(timer_wheel&&) = delete;
+
+    // Drops the callbacks that are not due yet.
+    ~timer_wheel() {
+        {
+            const std::scoped_lock<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    void schedule(std::chrono::steady_clock::duration delay,
+        std::function<void()> callback) {
+        const auto now = std::chrono::steady_clock::now();
+        bool was_idle = false;
+        {
+            const std::scoped_lock<std::mutex> lock(mutex_);
+            was_idle = (pending_ == 0);
+            if (was_idle) {
+                next_tick_ = now + tick_;
+            }
+
+            // The first tick comes at next_tick_, every later one a tick apart.
+            using duration = std::chrono::steady_clock::duration;
+            const auto after_first = std::max(now + delay - next_tick_, duration::zero());
+            const auto ticks = static_cast<std::size_t>(
+                (after_first + tick_ - duration(1)) / tick_) + 1;
+
+            slots_.at((cursor_ + ticks) % SLOT_COUNT).push_back(
+                {(ticks - 1) / SLOT_COUNT, std::move(callback)});
+            ++pending_;
+        }
+
+        if (was_idle) {
+            wake_.notify_one();
+        }
+    }
+};
+
+} // namespace async
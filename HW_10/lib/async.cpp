@@ -1,15 +1,20 @@
 #if defined(_MSC_VER) && !defined(__clang__) && !defined(__INTEL_COMPILER)
 #include <chrono>
 #endif
+#include <algorithm>
 #include <condition_variable>
 #include <fstream>
 #include <iostream>
-#include <map>
 #include <mutex>
 #include <queue>
-#include <sstream>
 
 #include "async.h"
+#include "async_config.h"
+#include "context_table.hpp"
+#include "line_splitter.hpp"
+#include "segment_log.hpp"
+#include "spill_queue.hpp"
+#include "timer_wheel.hpp"
 
 namespace {
 const std::string& TASK_MANAGER_NAME() {
@@ -21,10 +26,157 @@ const std::string& TASK_MANAGER_NAME() {
 
 namespace async {
 
+// The commands of a block stored back to back in one string.
+class command_block {
+    std::string text;
+    std::vector<std::size_t> ends;
+public:
+    void add(std::string_view command) {
+        text += command;
+        ends.push_back(text.size());
+    }
+
+    [[nodiscard]] bool empty() const noexcept {
+        return ends.empty();
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return ends.size();
+    }
+
+    [[nodiscard]] std::string_view operator[](std::size_t index) const {
+        const std::size_t begin = (index == 0 ? 0 : ends[index - 1]);
+
+        return std::string_view(text).substr(begin, ends[index] - begin);
+    }
+
+    void clear() noexcept {
+        text.clear();
+        ends.clear();
+    }
+};
+
+// Counts the blocks built but not yet written by every writer. The backlog is
+// over from the moment the count goes past the high watermark until it falls
+// back to the low one, so producers pause and resume in batches.
+class output_backlog {
+    std::mutex mutex;
+    std::condition_variable drained;
+    std::atomic<std::size_t> blocks{0};
+    std::atomic<std::size_t> high{0};
+    std::atomic<std::size_t> low{0};
+    std::atomic<bool> over{false};
+    std::atomic<std::uint64_t> dropped{0};
+public:
+    void set_watermarks(std::size_t high_mark, std::size_t low_mark) {
+        high = high_mark;
+        low = (high_mark == 0 ? 0 : std::min(low_mark, high_mark - 1));
+    }
+
+    void add() {
+        const std::size_t count = blocks.fetch_add(1) + 1;
+        const std::size_t high_mark = high.load(std::memory_order_relaxed);
+
+        if (high_mark > 0 && count > high_mark && !over.load()) {
+            const std::scoped_lock<std::mutex> lock(mutex);
+            if (blocks.load() > high_mark) {
+                over = true;
+            }
+        }
+    }
+
+    void remove() {
+        const std::size_t count = blocks.fetch_sub(1) - 1;
+        bool resumed = false;
+
+        if (over.load() && count <= low.load(std::memory_order_relaxed)) {
+            const std::scoped_lock<std::mutex> lock(mutex);
+            resumed = over.load() && blocks.load() <= low.load();
+            if (resumed) {
+                over = false;
+            }
+        }
+
+        if (resumed) {
+            drained.notify_all();
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return blocks.load();
+    }
+
+    [[nodiscard]] bool overloaded() const noexcept {
+        return over.load();
+    }
+
+    void count_drop(std::uint64_t count) noexcept {
+        dropped += count;
+    }
+
+    [[nodiscard]] std::uint64_t dropped_count() const noexcept {
+        return dropped.load();
+    }
+
+    void wait_until_drained() {
+        if (over.load()) {
+            std::unique_lock<std::mutex> lock(mutex);
+            drained.wait(lock, [this] { return !over.load(); });
+        }
+    }
+
+    // Waits for the backlog to leave the over state or for notify(); the
+    // predicate runs with the backlog locked.
+    template <typename Predicate>
+    void wait(const Predicate& predicate) {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, predicate);
+    }
+
+    // Applies the update with the backlog locked and wakes every waiter, so a
+    // wait() predicate reading what the update changes cannot miss it.
+    template <typename Update>
+    void notify(const Update& update) {
+        {
+            const std::scoped_lock<std::mutex> lock(mutex);
+            update();
+        }
+
+        drained.notify_all();
+    }
+};
+
+namespace {
+output_backlog& backlog() {
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+    static auto* instance = new output_backlog;
+
+    return *instance;
+}
+} // namespace
+
+// Keeps a block counted in the backlog for as long as it lives.
+class backlog_entry {
+public:
+    backlog_entry() noexcept {
+        backlog().add();
+    }
+
+    backlog_entry(const backlog_entry&) = delete;
+    backlog_entry(backlog_entry&&) = delete;
+    backlog_entry& operator=(const backlog_entry&) = delete;
+    backlog_entry& operator=(backlog_entry&&) = delete;
+
+    ~backlog_entry() {
+        backlog().remove();
+    }
+};
+
+// A finished block; the console and file writers share one immutable copy.
 struct OutputTask {
     OutputTask() = default;
     OutputTask(std::chrono::system_clock::time_point timestamp, std::string context_id,
-        std::vector<std::string>&& commands) : timestamp_(timestamp),
+        command_block&& commands) noexcept : timestamp_(timestamp),
         context_id_(std::move(context_id)), commands_(std::move(commands)) {}
 
     [[nodiscard]] const std::chrono::system_clock::time_point& get_timestamp() const {
@@ -35,154 +187,364 @@ struct OutputTask {
         return context_id_;
     }
 
-    [[nodiscard]] const std::vector<std::string>& get_commands() const {
+    [[nodiscard]] const command_block& get_commands() const {
         return commands_;
     }
 private:
+    backlog_entry entry_;
     std::chrono::system_clock::time_point timestamp_;
     std::string context_id_;
-    std::vector<std::string> commands_;
+    command_block commands_;
+};
+
+using output_block = std::shared_ptr<const OutputTask>;
+
+// Every output thread drains a queue of its own, so a push wakes exactly the
+// thread that will write the block.
+class output_queue {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::queue<output_block> tasks;
+    bool stopping = false;
+public:
+    void push(output_block task) {
+        bool was_empty = false;
+        {
+            const std::scoped_lock<std::mutex> lock(mutex);
+            was_empty = tasks.empty();
+            tasks.push(std::move(task));
+        }
+
+        // The only consumer drains the queue before it waits again, so it
+        // needs a wakeup only for the first task after it ran dry.
+        if (was_empty) {
+            ready.notify_one();
+        }
+    }
+
+    // Blocks until a task is queued; returns false once stopped and drained.
+    bool pop(output_block& task) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !tasks.empty() || stopping; });
+        if (tasks.empty()) {
+            return false;
+        }
+
+        task = std::move(tasks.front());
+        tasks.pop();
+
+        return true;
+    }
+
+    // Like pop(), but takes every queued task at once.
+    bool pop_all(std::vector<output_block>& batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !tasks.empty() || stopping; });
+        if (tasks.empty()) {
+            return false;
+        }
+
+        for (; !tasks.empty(); tasks.pop()) {
+            batch.emplace_back(std::move(tasks.front()));
+        }
+
+        return true;
+    }
+
+    void stop() {
+        {
+            const std::scoped_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        ready.notify_all();
+    }
 };
 
+namespace {
+void flush_expired_block(std::size_t shard, std::uint64_t number);
+void enqueue(output_block task);
+void dispatch(output_block task);
+} // namespace
+
+// Keeps the blocks built while the backlog is over in a file, and queues them
+// again from a thread of its own once the writers are back under the low
+// watermark. While any block is spilled, new ones are spilled behind it, so
+// the writers still get the blocks in order.
+class spill_stage {
+    std::mutex mutex;
+    spill_queue file;
+    std::atomic<std::size_t> spilled{0};
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+
+    // A block is stored as its timestamp, context id and commands, one per
+    // line; commands never contain a newline.
+    static std::string serialize(const OutputTask& task) {
+        std::string record =
+            std::to_string(task.get_timestamp().time_since_epoch().count());
+        record += '\n';
+        record += task.get_context_id();
+        record += '\n';
+        for (std::size_t i = 0; i < task.get_commands().size(); ++i) {
+            record += task.get_commands()[i];
+            record += '\n';
+        }
+
+        return record;
+    }
+
+    static output_block deserialize(std::string_view record) {
+        std::vector<std::string_view> fields;
+        for (std::size_t end = record.find('\n'); end != std::string_view::npos;
+            end = record.find('\n')) {
+            fields.push_back(record.substr(0, end));
+            record.remove_prefix(end + 1);
+        }
+
+        command_block commands;
+        for (std::size_t i = 2; i < fields.size(); ++i) {
+            commands.add(fields[i]);
+        }
+
+        const std::chrono::system_clock::duration since_epoch(
+            std::stoll(std::string(fields.at(0))));
+
+        return std::make_shared<const OutputTask>(
+            std::chrono::system_clock::time_point(since_epoch),
+            std::string(fields.at(1)), std::move(commands));
+    }
+
+    // Queues spilled blocks until the backlog is over again or, when draining,
+    // until none is left.
+    void replay(bool draining) {
+        const std::scoped_lock<std::mutex> lock(mutex);
+        std::string record;
+        std::size_t lost = 0;
+
+        while ((draining || !backlog().overloaded()) && file.pop(record, lost)) {
+            --spilled;
+            enqueue(deserialize(record));
+        }
+
+        if (lost > 0) {
+            spilled -= lost;
+            backlog().count_drop(lost);
+        }
+    }
+
+    void run() {
+        for (;;) {
+            backlog().wait([this] {
+                return stopping.load() || (spilled.load() > 0 && !backlog().overloaded());
+            });
+            if (stopping.load()) {
+                return;
+            }
+
+            replay(false);
+        }
+    }
+public:
+    explicit spill_stage(std::string path) :
+        file(std::move(path)), thread([this] { run(); }) {}
+
+    spill_stage(const spill_stage&) = delete;
+    spill_stage(spill_stage&&) = delete;
+    spill_stage& operator=(const spill_stage&) = delete;
+    spill_stage& operator=(spill_stage&&) = delete;
+
+    // Hands every spilled block to the writers, whatever the backlog.
+    ~spill_stage() {
+        backlog().notify([this] { stopping = true; });
+        thread.join();
+        replay(true);
+    }
+
+    void submit(output_block task) {
+        const std::scoped_lock<std::mutex> lock(mutex);
+        if (spilled.load() == 0 && !backlog().overloaded()) {
+            enqueue(std::move(task));
+        } else if (file.push(serialize(*task))) {
+            backlog().notify([this] { ++spilled; });
+        } else {
+            backlog().count_drop(1);
+        }
+    }
+};
+
+// Assembles the static blocks of the connections routed to one shard.
 class taskmanager {
+    std::mutex mutex;
+    std::uint64_t static_block_number = 0;
     std::chrono::system_clock::time_point static_block_timestamp;
     std::size_t max_static_task_count;
-    std::vector<std::string> static_block_task;
+    std::size_t shard;
+    std::string shard_id;
+    command_block static_block_task;
 public:
-    explicit taskmanager(const std::size_t max_task_count):
-        max_static_task_count(max_task_count) {}
+    taskmanager(const std::size_t max_task_count, const std::size_t shard_index):
+        max_static_task_count(max_task_count), shard(shard_index),
+        shard_id(std::to_string(shard_index)) {}
 
     void add_task(std::string_view task) {
+        const std::scoped_lock<std::mutex> lock(mutex);
         if (static_block_task.empty()) {
             static_block_timestamp = std::chrono::system_clock::now();
+            ++static_block_number;
+            if (flush_timer()) {
+                flush_timer()->schedule(flush_latency.load(),
+                    [target = shard, number = static_block_number]() noexcept {
+                        flush_expired_block(target, number);
+                    });
+            }
         }
 
-        static_block_task.emplace_back(task);
+        static_block_task.add(task);
         if (static_block_task.size() >= max_static_task_count) {
-            process_tasks(static_block_task, static_block_timestamp);
+            process_tasks(static_block_task, static_block_timestamp, shard_id);
         }
     }
 
-    static void process_tasks(std::vector<std::string>& block_task,
-        const std::chrono::system_clock::time_point& timestamp) {
-        process_tasks(block_task, timestamp, "0");
-    }
-
-    static void process_tasks(std::vector<std::string>& block_task,
+    static void process_tasks(command_block& block_task,
         const std::chrono::system_clock::time_point& timestamp,
         const std::string& context_id) {
         if (block_task.empty()) [[unlikely]] {
             return;
         }
 
-        const OutputTask task(timestamp, context_id, std::move(block_task));
-
-        {
-            const std::scoped_lock<std::mutex> lock(queue_mutex());
-            log_queue().push(task);
-            file_queue().push(task);
-        }
-
-        queue_cv().notify_all();
+        dispatch(std::make_shared<const OutputTask>(timestamp, context_id,
+            std::move(block_task)));
 
         block_task.clear();
     }
 
     void finish() {
+        const std::scoped_lock<std::mutex> lock(mutex);
         if (!static_block_task.empty()) {
-            process_tasks(static_block_task, static_block_timestamp);
+            process_tasks(static_block_task, static_block_timestamp, shard_id);
+        }
+    }
+
+    // Called by the flush timer; the block may have been emitted since.
+    void flush_static_block(std::uint64_t number) {
+        const std::scoped_lock<std::mutex> lock(mutex);
+        if (number == static_block_number && !static_block_task.empty()) {
+            process_tasks(static_block_task, static_block_timestamp, shard_id);
         }
     }
 
-    static std::atomic<bool> should_terminate;
     static std::atomic<bool> threads_initialized;
+    static std::atomic<std::chrono::milliseconds> flush_latency;
+    static std::atomic<overflow_policy> overflow;
+    static std::atomic<std::size_t> next_file_queue;
+    static std::size_t shard_count;
 
-    static std::condition_variable& queue_cv() {
+    static std::unique_ptr<timer_wheel>& flush_timer() {
         // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-        static auto* condition = new std::condition_variable();
+        static auto* timer = new std::unique_ptr<timer_wheel>;
 
-        return *condition;
+        return *timer;
     }
 
-    static std::mutex& queue_mutex() {
-        static std::mutex mutex;
-
-        return mutex;
-    }
-
-    static std::queue<OutputTask>& file_queue() {
+    static std::unique_ptr<spill_stage>& spill() {
         // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-        static auto* queue = new std::queue<OutputTask>;
+        static auto* stage = new std::unique_ptr<spill_stage>;
 
-        return *queue;
+        return *stage;
     }
 
-    static std::queue<OutputTask>& log_queue() {
+    static std::unique_ptr<output_queue>& console_queue() {
         // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-        static auto* queue = new std::queue<OutputTask>;
+        static auto* queue = new std::unique_ptr<output_queue>;
 
         return *queue;
     }
 
-    static std::thread& file_thread1() {
+    static std::vector<std::unique_ptr<output_queue>>& file_queues() {
         // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-        static auto* thread = new std::thread;
+        static auto* queues = new std::vector<std::unique_ptr<output_queue>>;
 
-        return *thread;
+        return *queues;
     }
 
-    static std::thread& file_thread2() {
+    static std::thread& console_thread() {
         // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
         static auto* thread = new std::thread;
 
         return *thread;
     }
 
-    static std::thread& log_thread() {
+    static std::vector<std::thread>& file_threads() {
         // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-        static auto* thread = new std::thread;
+        static auto* threads = new std::vector<std::thread>;
 
-        return *thread;
+        return *threads;
     }
 };
 
-std::atomic<bool> taskmanager::should_terminate{false};
 std::atomic<bool> taskmanager::threads_initialized{false};
+std::size_t taskmanager::shard_count{1};
+std::atomic<std::chrono::milliseconds> taskmanager::flush_latency{
+    std::chrono::milliseconds{0}};
+std::atomic<overflow_policy> taskmanager::overflow{overflow_policy::block};
+std::atomic<std::size_t> taskmanager::next_file_queue{0};
 
 struct ConnectionContext {
+    taskmanager* aggregator = nullptr;
     int dynamic_block_nesting_level = 0;
     std::chrono::system_clock::time_point dynamic_block_timestamp;
     std::string id;
-    std::vector<std::string> dynamic_block_task;
+    command_block dynamic_block_task;
+    line_splitter lines;
 };
 
 namespace {
+std::mutex& config_mutex() {
+    static std::mutex mutex;
+
+    return mutex;
+}
+
+config& current_config() {
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+    static auto* settings = new config;
+
+    return *settings;
+}
+
 std::mutex& contexts_mutex() {
     static std::mutex mutex;
 
     return mutex;
 }
 
-std::map<void*, std::unique_ptr<ConnectionContext>>& contexts() {
+context_table<ConnectionContext>& contexts() {
     // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    static auto* contexts_map = new std::map<void*, std::unique_ptr<ConnectionContext>>;
+    static auto* table = new context_table<ConnectionContext>;
 
-    return *contexts_map;
+    return *table;
 }
 
-std::unique_ptr<taskmanager>& shared_task_manager() {
+// One aggregator mixes the static commands of every connection; in relaxed
+// mode each of several gets the connections whose id falls into its shard.
+std::vector<std::unique_ptr<taskmanager>>& static_aggregators() {
     // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-    static auto* manager = new std::unique_ptr<taskmanager>;
+    static auto* aggregators = new std::vector<std::unique_ptr<taskmanager>>;
 
-    return *manager;
+    return *aggregators;
 }
 
-void process_command(ConnectionContext* context, const std::string& command) {
+void flush_expired_block(std::size_t shard, std::uint64_t number) {
+    if (shard < static_aggregators().size()) {
+        static_aggregators()[shard]->flush_static_block(number);
+    }
+}
+
+void process_command(ConnectionContext* context, std::string_view command) {
     if (command == "{") {
         if (context->dynamic_block_nesting_level == 0) {
-            if (shared_task_manager()) {
-                shared_task_manager()->finish();
-            }
+            context->aggregator->finish();
 
             context->dynamic_block_timestamp = std::chrono::system_clock::now();
         }
@@ -191,151 +553,227 @@ void process_command(ConnectionContext* context, const std::string& command) {
     } else if (command == "}") {
         context->dynamic_block_nesting_level--;
         if (context->dynamic_block_nesting_level == 0) {
-            if (shared_task_manager()) {
-                taskmanager::process_tasks(context->dynamic_block_task,
-                    context->dynamic_block_timestamp, context->id);
-            }
+            taskmanager::process_tasks(context->dynamic_block_task,
+                context->dynamic_block_timestamp, context->id);
         }
     } else if (!command.empty()) {
         if (context->dynamic_block_nesting_level > 0) {
-            context->dynamic_block_task.emplace_back(command);
+            context->dynamic_block_task.add(command);
         } else {
-            if (shared_task_manager()) {
-                shared_task_manager()->add_task(command);
-            }
+            context->aggregator->add_task(command);
         }
     }
 }
 
-void log_worker() {
-    while (true) {
-        OutputTask task;
-        {
-            std::unique_lock<std::mutex> lock(taskmanager::queue_mutex());
-            taskmanager::queue_cv().wait(lock, [] {
-                return !taskmanager::log_queue().empty() || taskmanager::should_terminate;
-            });
+void enqueue(output_block task) {
+    auto& writers = taskmanager::file_queues();
 
-            if (taskmanager::should_terminate && taskmanager::log_queue().empty()) {
-                break;
-            }
-
-            if (!taskmanager::log_queue().empty()) {
-                task = taskmanager::log_queue().front();
-                taskmanager::log_queue().pop();
-            }
-        }
+    taskmanager::console_queue()->push(task);
+    writers[taskmanager::next_file_queue++ % writers.size()]->push(std::move(task));
+}
 
-        if (!task.get_commands().empty()) {
-            std::cout << TASK_MANAGER_NAME() << ": ";
+// Hands a block to the writers, or applies the overflow policy to it while
+// the backlog is over.
+void dispatch(output_block task) {
+    if (taskmanager::spill()) {
+        taskmanager::spill()->submit(std::move(task));
+    } else if (taskmanager::overflow == overflow_policy::drop
+        && backlog().overloaded()) {
+        backlog().count_drop(1);
+    } else {
+        enqueue(std::move(task));
+    }
+}
 
-            const std::string_view delimiter = ", ";
-            for (std::size_t i = 0; i < task.get_commands().size(); ++i) {
-                std::cout << task.get_commands()[i];
-                if (i < task.get_commands().size() - 1) {
-                    std::cout << delimiter;
-                }
-            }
+// Appends the "bulk: a, b, c" line of a block.
+void render_block(const OutputTask& task, std::string& line) {
+    static const std::string prefix = TASK_MANAGER_NAME() + ": ";
+    const std::string_view delimiter = ", ";
 
-            std::cout << '\n';
+    line += prefix;
+    for (std::size_t i = 0; i < task.get_commands().size(); ++i) {
+        if (i > 0) {
+            line += delimiter;
         }
+
+        line += task.get_commands()[i];
     }
-}
 
-void file_worker(const int thread_id) {
-    static std::atomic<int> file_counter{0};
-    while (true) {
-        OutputTask task;
-        bool has_task = false;
-        {
-            std::unique_lock<std::mutex> lock(taskmanager::queue_mutex());
-            taskmanager::queue_cv().wait(lock, [] {
-                return   !taskmanager::file_queue().empty()
-                      || taskmanager::should_terminate;
-            });
+    line += '\n';
+}
 
-            if (taskmanager::should_terminate && taskmanager::file_queue().empty()) {
-                break;
-            }
+// Renders every block queued since the last wakeup and hands them to the
+// stream in one write, so a burst of blocks costs one call into iostreams.
+void log_worker(output_queue& queue) {
+    std::vector<output_block> batch;
+    std::string lines;
 
-            if (!taskmanager::file_queue().empty()) {
-                task = taskmanager::file_queue().front();
-                taskmanager::file_queue().pop();
-                has_task = true;
+    while (queue.pop_all(batch)) {
+        for (const auto& task : batch) {
+            if (!task->get_commands().empty()) {
+                render_block(*task, lines);
             }
         }
 
-        if (has_task && !task.get_commands().empty()) {
+        std::cout.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+        lines.clear();
+        batch.clear();
+    }
+}
+
+void file_worker(output_queue& queue, const std::size_t thread_id) {
+    static std::atomic<int> file_counter{0};
+    output_block task;
+    std::string line;
+    while (queue.pop(task)) {
+        if (!task->get_commands().empty()) {
             auto timestamp_seconds = std::chrono::duration_cast<std::chrono::seconds>(
-                task.get_timestamp().time_since_epoch()).count();
+                task->get_timestamp().time_since_epoch()).count();
 
             const std::string filename = TASK_MANAGER_NAME()
-                + std::to_string(timestamp_seconds) + "_" + task.get_context_id() + "_"
+                + std::to_string(timestamp_seconds) + "_" + task->get_context_id() + "_"
                 + std::to_string(thread_id) + "_" + std::to_string(file_counter++)
                 + ".log";
 
             std::ofstream file(filename);
             if (file.is_open()) {
-                file << TASK_MANAGER_NAME() << ": ";
-
-                const std::string delimiter = ", ";
-                for (std::size_t i = 0; i < task.get_commands().size(); ++i) {
-                    file << task.get_commands()[i];
-                    if (i < task.get_commands().size() - 1) {
-                        file << delimiter;
-                    }
-                }
-
-                file << '\n';
+                line.clear();
+                render_block(*task, line);
+                file.write(line.data(), static_cast<std::streamsize>(line.size()));
                 file.close();
             }
         }
     }
 }
 
+void segment_worker(output_queue& queue, const std::size_t thread_id,
+    const config& settings) {
+    segment_log log(TASK_MANAGER_NAME() + "_segment_" + std::to_string(thread_id) + "_",
+        settings.segment_bytes, settings.segment_age, settings.sync_segments);
+    std::vector<output_block> batch;
+    std::vector<std::string> records;
+
+    while (queue.pop_all(batch)) {
+        for (const auto& task : batch) {
+            if (task->get_commands().empty()) {
+                continue;
+            }
+
+            std::string payload;
+            render_block(*task, payload);
+
+            const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+                task->get_timestamp().time_since_epoch()).count();
+            std::string header = "#";
+            header += std::to_string(seconds);
+            header += ' ';
+            header += task->get_context_id();
+            header += ' ';
+            header += std::to_string(payload.size());
+            header += '\n';
+            // One record per block, so rotation never parts a header from
+            // its payload.
+            header += payload;
+
+            records.emplace_back(std::move(header));
+        }
+
+        log.append(records);
+        records.clear();
+        batch.clear();
+    }
+}
+
+// Callers hold contexts_mutex(), which also serializes stop_threads().
 void init_threads() {
-    if (!taskmanager::threads_initialized.exchange(true)) {
-        taskmanager::should_terminate = false;
+    if (!taskmanager::threads_initialized) {
+        config settings;
+        {
+            const std::scoped_lock<std::mutex> lock(config_mutex());
+            settings = current_config();
+        }
+
+        const std::size_t writer_count = std::max<std::size_t>(settings.file_writers, 1);
+        constexpr std::chrono::milliseconds::rep TICKS_PER_LATENCY = 16;
+
+        auto& queues = taskmanager::file_queues();
+
+        taskmanager::console_queue() = std::make_unique<output_queue>();
+        taskmanager::console_thread() =
+            std::thread(log_worker, std::ref(*taskmanager::console_queue()));
+
+        queues.clear();
+        for (std::size_t writer = 0; writer < writer_count; ++writer) {
+            queues.emplace_back(std::make_unique<output_queue>());
+            if (settings.format == file_format::segments) {
+                taskmanager::file_threads().emplace_back(
+                    segment_worker, std::ref(*queues.back()), writer + 1, settings);
+            } else {
+                taskmanager::file_threads().emplace_back(
+                    file_worker, std::ref(*queues.back()), writer + 1);
+            }
+        }
 
-        taskmanager::log_thread() = std::thread(log_worker);
-        taskmanager::file_thread1() = std::thread(file_worker, 1);
-        taskmanager::file_thread2() = std::thread(file_worker, 2);
+        backlog().set_watermarks(settings.high_watermark, settings.low_watermark);
+        taskmanager::overflow = settings.overflow;
+        taskmanager::shard_count = (settings.mixing == static_mixing::relaxed
+            ? std::max<std::size_t>(settings.static_shards, 1) : 1);
+        if (settings.high_watermark > 0 && settings.overflow == overflow_policy::spill) {
+            taskmanager::spill() =
+                std::make_unique<spill_stage>(TASK_MANAGER_NAME() + "_spill.tmp");
+        }
+
+        if (settings.max_latency.count() > 0) {
+            taskmanager::flush_latency = settings.max_latency;
+            taskmanager::flush_timer() = std::make_unique<timer_wheel>(std::max(
+                settings.max_latency / TICKS_PER_LATENCY, std::chrono::milliseconds(1)));
+        }
+
+        // Published last, once every queue and thread is in place.
+        taskmanager::threads_initialized = true;
     }
 }
 
 void stop_threads() {
     if (taskmanager::threads_initialized.exchange(false)) {
-        if(shared_task_manager()) {
-            shared_task_manager()->finish();
+        taskmanager::flush_timer().reset();
+        for (const auto& aggregator : static_aggregators()) {
+            aggregator->finish();
         }
 
-        taskmanager::should_terminate = true;
-        taskmanager::queue_cv().notify_all();
-
-        if (taskmanager::log_thread().joinable()) {
-            taskmanager::log_thread().join();
+        taskmanager::spill().reset();
+        taskmanager::console_queue()->stop();
+        for (auto& queue : taskmanager::file_queues()) {
+            queue->stop();
         }
 
-        if (taskmanager::file_thread1().joinable()) {
-            taskmanager::file_thread1().join();
+        if (taskmanager::console_thread().joinable()) {
+            taskmanager::console_thread().join();
         }
 
-        if (taskmanager::file_thread2().joinable()) {
-            taskmanager::file_thread2().join();
+        for (auto& thread : taskmanager::file_threads()) {
+            thread.join();
         }
 
-        if (shared_task_manager()) {
-            shared_task_manager().reset();
-        }
+        taskmanager::file_threads().clear();
+        static_aggregators().clear();
     }
 }
 } // namespace
 
+void configure(const config& settings) {
+    const std::scoped_lock<std::mutex> lock(config_mutex());
+    current_config() = settings;
+}
+
 handle_t connect(std::size_t bulk) {
     const std::scoped_lock<std::mutex> lock(contexts_mutex());
-    if (!shared_task_manager()) {
-        shared_task_manager() = std::make_unique<taskmanager>(bulk);
+    auto& aggregators = static_aggregators();
+    if (aggregators.empty()) {
         init_threads();
+        for (std::size_t shard = 0; shard < taskmanager::shard_count; ++shard) {
+            aggregators.emplace_back(std::make_unique<taskmanager>(bulk, shard));
+        }
     }
 
     static std::atomic<int> next_id{0};
@@ -343,37 +781,34 @@ handle_t connect(std::size_t bulk) {
 
     auto context = std::make_unique<ConnectionContext>();
     context->id = std::to_string(unique_id);
-    auto *handle = static_cast<handle_t>(context.get());
-    contexts()[handle] = std::move(context);
+    context->aggregator =
+        aggregators[static_cast<std::size_t>(unique_id) % aggregators.size()].get();
 
-    return handle;
+    return contexts().insert(std::move(context));
 }
 
-void receive(handle_t handle, const char *data, std::size_t size) {
-    if (handle == nullptr) {
-        return;
-    }
-
-    ConnectionContext* context = nullptr;
-    {
-        const std::scoped_lock<std::mutex> lock(contexts_mutex());
-        auto context_iterator = contexts().find(handle);
-        if (context_iterator != contexts().end()) {
-            context = context_iterator->second.get();
-        }
-    }
+std::size_t queued_blocks() {
+    return backlog().size();
+}
 
-    if (context == nullptr) {
-        return;
-    }
+bool output_throttled() {
+    return backlog().overloaded();
+}
 
-    const std::string input(data, size);
-    std::istringstream stream(input);
-    std::string command;
+std::uint64_t dropped_blocks() {
+    return backlog().dropped_count();
+}
 
-    while (std::getline(stream, command)) {
-        process_command(context, command);
+void receive(handle_t handle, const char *data, std::size_t size) {
+    if (taskmanager::overflow == overflow_policy::block) {
+        backlog().wait_until_drained();
     }
+
+    contexts().visit(handle, [data, size](ConnectionContext& context) {
+        context.lines.feed({data, size}, [&context](std::string_view command) {
+            process_command(&context, command);
+        });
+    });
 }
 
 void disconnect(handle_t handle) {
@@ -381,14 +816,17 @@ void disconnect(handle_t handle) {
         return;
     }
 
-    std::unique_ptr<ConnectionContext> context;
-    {
-        const std::scoped_lock<std::mutex> lock(contexts_mutex());
-        auto context_iterator = contexts().find(handle);
-        if (context_iterator != contexts().end()) {
-            context = std::move(context_iterator->second);
-            contexts().erase(context_iterator);
-        }
+    // Connect and every closing connection take the same lock before the
+    // context leaves the table, so the last disconnect cannot stop the threads
+    // while another one still flushes. Receives never take it, so erase() can
+    // wait for them under it.
+    const std::scoped_lock<std::mutex> lock(contexts_mutex());
+    const std::unique_ptr<ConnectionContext> context = contexts().erase(handle);
+
+    if (context) {
+        context->lines.finish([&context](std::string_view command) {
+            process_command(context.get(), command);
+        });
     }
 
     if (contexts().empty()) {
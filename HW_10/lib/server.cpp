@@ -2,6 +2,8 @@
 #include <csignal>
 #endif
 
+#include <thread>
+
 #include <server_p.hpp>
 
 namespace
@@ -30,8 +32,16 @@ namespace async
         const std::uint16_t port,
         const std::size_t   bulk_size)
         :
-        pimpl_(std::make_unique<ServerImpl>(std::make_unique<boost::asio::io_context>(),
-            port, bulk_size))
+        Server(port, bulk_size, 1) {}
+
+    Server::Server(
+        const std::uint16_t port,
+        const std::size_t   bulk_size,
+        const std::size_t   thread_count)
+        :
+        pimpl_(std::make_unique<ServerImpl>(std::make_unique<boost::asio::io_context>(
+                static_cast<int>(std::max<std::size_t>(thread_count, 1))),
+            port, bulk_size, thread_count))
     {
         pimpl_->start_accept();
     }
@@ -40,7 +50,22 @@ namespace async
 
     void Server::run()
     {
+        std::vector<std::thread> workers;
+
+        workers.reserve(pimpl_->thread_count_ - 1);
+        for (std::size_t i = 1; i < pimpl_->thread_count_; ++i)
+        {
+            workers.emplace_back([this]()
+            {
+                pimpl_->io_context_->run();
+            });
+        }
+
         pimpl_->io_context_->run();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
     }
 
     void Server::stop()
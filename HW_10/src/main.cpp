@@ -2,6 +2,7 @@
 #include <iostream>
 #include <ranges>
 
+#include <async_config.h>
 #include <server.hpp>
 
 int main(
@@ -20,10 +21,14 @@ int main(
             });
         std::uint16_t port = 0;
         std::size_t bulk_size = 0;
+        std::size_t thread_count = 1;
+        // Zero keeps every connection on one aggregator (static_mixing::strict).
+        std::size_t static_shards = 0;
 
-        if (args.size() != 3)
+        if (args.size() < 3 || args.size() % 2 == 0)
         {
-            std::cerr << "Usage: " << args[0] << " <port> <bulk_size>\n";
+            std::cerr << "Usage: " << args[0]
+                << " <port> <bulk_size> [--threads <count>] [--static_shards <count>]\n";
             ret = -1;
 
             return ret;
@@ -55,7 +60,56 @@ int main(
             }
         }
 
-        async::Server server(port, bulk_size);
+        for (std::ptrdiff_t index = 3; index + 1 < std::ssize(args); index += 2)
+        {
+            const std::string_view name = args[index];
+            const std::string_view value = args[index + 1];
+
+            if (name == "--threads")
+            {
+                auto [ptr, ec] = std::from_chars(value.data(),
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                    value.data() + value.size(), thread_count, BASE);
+                if (ec != std::errc{} || thread_count == 0)
+                {
+                    std::cerr << "Invalid thread count format\n";
+                    ret = -4;
+
+                    return ret;
+                }
+            }
+            else if (name == "--static_shards")
+            {
+                auto [ptr, ec] = std::from_chars(value.data(),
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                    value.data() + value.size(), static_shards, BASE);
+                if (ec != std::errc{} || static_shards == 0)
+                {
+                    std::cerr << "Invalid static shard count format\n";
+                    ret = -5;
+
+                    return ret;
+                }
+            }
+            else
+            {
+                std::cerr << "Unknown option " << name << '\n';
+                ret = -1;
+
+                return ret;
+            }
+        }
+
+        if (static_shards != 0)
+        {
+            async::config settings;
+
+            settings.mixing = async::static_mixing::relaxed;
+            settings.static_shards = static_shards;
+            async::configure(settings);
+        }
+
+        async::Server server(port, bulk_size, thread_count);
 
         server.setup_signal_handling();
         server.run();
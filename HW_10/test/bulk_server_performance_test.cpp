@@ -0,0 +1,611 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <async_config.h>
+#include <server.hpp>
+#include <wrapper_boost_asio.hpp>
+
+namespace
+{
+    constexpr unsigned char BASE = 10;
+
+    struct LoadSpec
+    {
+        std::uint16_t port{9100};
+        std::size_t connections{1000};
+        std::size_t commands{100};
+        std::size_t bulk_size{10};
+        std::size_t threads{1};
+        // Aggregators of static_mixing::relaxed; zero keeps the strict mixing.
+        std::size_t static_shards{0};
+        // Commands per second over all connections; zero sends without pause.
+        std::size_t rate{0};
+        // Share of the commands sent inside dynamic blocks.
+        std::size_t dynamic_percent{10};
+    };
+
+    struct BlockStats
+    {
+        std::uint64_t commands{0};
+        std::uint64_t untimed_blocks{0};
+        std::int64_t last_written_ns{0};
+        std::vector<double> latencies_ms{};
+    };
+
+    [[nodiscard]] std::int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    bool parse_option(
+        const std::span<char*>& arguments,
+        std::size_t&            index,
+        LoadSpec&               spec)
+    {
+        const std::string_view name = arguments[index];
+        std::size_t value = 0;
+
+        if (index + 1 >= arguments.size())
+        {
+            return false;
+        }
+
+        const std::string_view text = arguments[++index];
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(),
+            value, BASE);
+        if (ec != std::errc{})
+        {
+            return false;
+        }
+
+        if (name == "--port")
+        {
+            spec.port = static_cast<std::uint16_t>(value);
+        }
+        else if (name == "--connections")
+        {
+            spec.connections = value;
+        }
+        else if (name == "--commands")
+        {
+            spec.commands = value;
+        }
+        else if (name == "--bulk")
+        {
+            spec.bulk_size = value;
+        }
+        else if (name == "--threads")
+        {
+            spec.threads = value;
+        }
+        else if (name == "--static-shards")
+        {
+            spec.static_shards = value;
+        }
+        else if (name == "--rate")
+        {
+            spec.rate = value;
+        }
+        else if (name == "--dynamic-percent")
+        {
+            spec.dynamic_percent = std::min<std::size_t>(value, 100);
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    void write_all(
+        boost::asio::ip::tcp::socket& socket,
+        std::string_view              data)
+    {
+        while (!data.empty())
+        {
+            data.remove_prefix(socket.write_some(boost::asio::buffer(data)));
+        }
+    }
+
+    // Every command is the time it was sent in nanoseconds, so the output
+    // files alone tell when the commands of each block left the client.
+    // Returns the commands sent.
+    std::uint64_t send_load(
+        const LoadSpec&                              spec,
+        std::vector<boost::asio::ip::tcp::socket>&   sockets)
+    {
+        constexpr std::size_t DYNAMIC_BLOCK_SIZE = 4;
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::size_t> sent(sockets.size(), 0);
+        std::uint64_t total = 0;
+        std::uint64_t dynamic = 0;
+        std::string group;
+
+        for (bool pending = true; pending;)
+        {
+            pending = false;
+            for (std::size_t connection = 0; connection < sockets.size(); ++connection)
+            {
+                if (sent[connection] >= spec.commands)
+                {
+                    continue;
+                }
+
+                const bool as_dynamic = spec.dynamic_percent > 0
+                    && dynamic * 100 <= spec.dynamic_percent * total;
+                const std::size_t count = as_dynamic
+                    ? std::min(DYNAMIC_BLOCK_SIZE, spec.commands - sent[connection]) : 1;
+
+                group.clear();
+                if (as_dynamic)
+                {
+                    group += "{\n";
+                }
+
+                for (std::size_t command = 0; command < count; ++command)
+                {
+                    group += std::to_string(now_ns());
+                    group += '\n';
+                }
+
+                if (as_dynamic)
+                {
+                    group += "}\n";
+                    dynamic += count;
+                }
+
+                write_all(sockets[connection], group);
+                sent[connection] += count;
+                total += count;
+                pending = pending || sent[connection] < spec.commands;
+
+                if (spec.rate > 0)
+                {
+                    const auto due = std::chrono::duration<double>(
+                        static_cast<double>(total) / static_cast<double>(spec.rate));
+
+                    std::this_thread::sleep_until(start
+                        + std::chrono::duration_cast<std::chrono::nanoseconds>(due));
+                }
+            }
+        }
+
+        return total;
+    }
+
+    // Runs in the server process: waits until no block is queued and no new
+    // file has shown up for a while, which is when every session has been
+    // closed and flushed.
+    void wait_for_output()
+    {
+        constexpr std::chrono::milliseconds POLL_INTERVAL{200};
+        std::size_t previous = 0;
+        std::size_t stable_polls = 0;
+
+        while (stable_polls < 2)
+        {
+            std::this_thread::sleep_for(POLL_INTERVAL);
+
+            const auto files = static_cast<std::size_t>(std::distance(
+                std::filesystem::directory_iterator("."),
+                std::filesystem::directory_iterator()));
+            stable_polls = (files == previous && async::queued_blocks() == 0)
+                ? stable_polls + 1 : 0;
+            previous = files;
+        }
+    }
+
+    // The latency of a block runs from sending its newest command to the
+    // moment its file was closed, both taken from the same clock. Blocks
+    // whose close was not seen are counted apart.
+    BlockStats collect_blocks(const std::unordered_map<std::string, std::int64_t>& closed)
+    {
+        constexpr std::string_view PREFIX = "bulk: ";
+        constexpr double NS_PER_MS = 1'000'000;
+        BlockStats stats;
+
+        for (const auto& entry : std::filesystem::directory_iterator("."))
+        {
+            const std::string filename = entry.path().filename().string();
+            if (!filename.starts_with("bulk") || !filename.ends_with(".log"))
+            {
+                continue;
+            }
+
+            const std::ifstream file(entry.path());
+            std::stringstream buffer;
+            std::int64_t newest = 0;
+
+            buffer << file.rdbuf();
+
+            std::string_view line = buffer.view();
+            if (!line.starts_with(PREFIX))
+            {
+                continue;
+            }
+
+            line.remove_prefix(PREFIX.size());
+            while (!line.empty())
+            {
+                std::int64_t sent = 0;
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                const auto [ptr, ec] = std::from_chars(line.data(),
+                    line.data() + line.size(), sent, BASE);
+                if (ec != std::errc{})
+                {
+                    break;
+                }
+
+                newest = std::max(newest, sent);
+                ++stats.commands;
+                line.remove_prefix(std::min(line.size(),
+                    static_cast<std::size_t>(ptr - line.data()) + 2));
+            }
+
+            const auto written = closed.find(filename);
+            if (written == closed.cend())
+            {
+                ++stats.untimed_blocks;
+                continue;
+            }
+
+            stats.latencies_ms.push_back(
+                static_cast<double>(written->second - newest) / NS_PER_MS);
+            stats.last_written_ns = std::max(stats.last_written_ns, written->second);
+        }
+
+        std::ranges::sort(stats.latencies_ms);
+
+        return stats;
+    }
+
+    [[nodiscard]] double percentile(
+        const std::vector<double>& sorted,
+        const double               fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0;
+        }
+
+        const auto index = static_cast<std::size_t>(
+            fraction * static_cast<double>(sorted.size() - 1));
+
+        return sorted[index];
+    }
+
+#if defined(__linux__)
+    void raise_descriptor_limit()
+    {
+        rlimit limit{};
+
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+
+    [[nodiscard]] double to_mib(const decltype(rusage::ru_maxrss) max_rss_kib)
+    {
+        constexpr double KIB_PER_MIB = 1024;
+
+        return static_cast<double>(max_rss_kib) / KIB_PER_MIB;
+    }
+
+    // Stamps every file closed after writing in the working directory with
+    // now_ns() as soon as the event is read, so that the latencies do not
+    // depend on how coarse the file system timestamps are.
+    class CloseWatcher
+    {
+        int descriptor_{-1};
+        std::atomic<bool> stopping_{false};
+        std::unordered_map<std::string, std::int64_t> closed_{};
+        std::thread thread_{};
+
+        // Returns false once nothing was left to read.
+        bool read_events()
+        {
+            constexpr std::size_t BUFFER_SIZE = 64 * 1024;
+            alignas(inotify_event) std::array<char, BUFFER_SIZE> buffer{};
+            const ssize_t length = ::read(descriptor_, buffer.data(), buffer.size());
+
+            if (length <= 0)
+            {
+                return false;
+            }
+
+            const std::int64_t now = now_ns();
+            for (std::size_t offset = 0; offset < static_cast<std::size_t>(length);)
+            {
+                inotify_event event{};
+
+                std::memcpy(&event, &buffer.at(offset), sizeof(event));
+                if (event.len > 0)
+                {
+                    const char* const name = &buffer.at(offset + sizeof(event));
+
+                    closed_.emplace(std::string(name, ::strnlen(name, event.len)), now);
+                }
+
+                offset += sizeof(event) + event.len;
+            }
+
+            return true;
+        }
+
+        void run()
+        {
+            constexpr int POLL_TIMEOUT_MS = 100;
+            pollfd watched{descriptor_, POLLIN, 0};
+
+            while (!stopping_.load())
+            {
+                if (::poll(&watched, 1, POLL_TIMEOUT_MS) > 0)
+                {
+                    read_events();
+                }
+            }
+
+            for (bool pending = true; pending;)
+            {
+                pending = read_events();
+            }
+        }
+    public:
+        CloseWatcher()
+            :
+            descriptor_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+        {
+            if (descriptor_ >= 0)
+            {
+                ::inotify_add_watch(descriptor_, ".", IN_CLOSE_WRITE);
+            }
+        }
+
+        CloseWatcher(const CloseWatcher&) = delete;
+        CloseWatcher(CloseWatcher&&) = delete;
+        CloseWatcher& operator=(const CloseWatcher&) = delete;
+        CloseWatcher& operator=(CloseWatcher&&) = delete;
+
+        ~CloseWatcher()
+        {
+            stop();
+            if (descriptor_ >= 0)
+            {
+                ::close(descriptor_);
+            }
+        }
+
+        void start()
+        {
+            if (descriptor_ >= 0)
+            {
+                thread_ = std::thread([this]()
+                {
+                    run();
+                });
+            }
+        }
+
+        // Reads the events still queued and stops.
+        void stop()
+        {
+            stopping_ = true;
+            if (thread_.joinable())
+            {
+                thread_.join();
+            }
+        }
+
+        [[nodiscard]] const std::unordered_map<std::string, std::int64_t>& closed() const
+        {
+            return closed_;
+        }
+    };
+
+    // The server runs in a child process of its own, so that its peak RSS is
+    // not mixed with the one of the load generator. It reports readiness
+    // through one pipe and waits on the other until the clients are done.
+    [[noreturn]] void run_server(
+        const LoadSpec& spec,
+        const int       ready_pipe,
+        const int       done_pipe)
+    {
+        std::ofstream null_output("/dev/null");
+        std::cout.rdbuf(null_output.rdbuf());
+
+        if (spec.static_shards != 0)
+        {
+            async::config settings;
+            settings.mixing = async::static_mixing::relaxed;
+            settings.static_shards = spec.static_shards;
+            async::configure(settings);
+        }
+
+        {
+            async::Server server(spec.port, spec.bulk_size, spec.threads);
+            std::thread server_thread([&server]()
+            {
+                server.run();
+            });
+            char token = 0;
+
+            static_cast<void>(::write(ready_pipe, &token, 1));
+            static_cast<void>(::read(done_pipe, &token, 1));
+            wait_for_output();
+            server.stop();
+            server_thread.join();
+        }
+
+        std::_Exit(EXIT_SUCCESS);
+    }
+
+    void run_benchmark(const LoadSpec& spec)
+    {
+        constexpr int LABEL_WIDTH = 22;
+        constexpr double P50 = 0.50;
+        constexpr double P90 = 0.90;
+        constexpr double P99 = 0.99;
+        std::array<int, 2> ready{-1, -1};
+        std::array<int, 2> done{-1, -1};
+
+        if (::pipe(ready.data()) != 0 || ::pipe(done.data()) != 0)
+        {
+            std::cerr << "Failed to create pipes: " << std::strerror(errno) << '\n';
+
+            return;
+        }
+
+        const pid_t server_pid = ::fork();
+        if (server_pid == 0)
+        {
+            ::close(ready[0]);
+            ::close(done[1]);
+            run_server(spec, ready[1], done[0]);
+        }
+
+        ::close(ready[1]);
+        ::close(done[0]);
+
+        char token = 0;
+        if (server_pid < 0 || ::read(ready[0], &token, 1) != 1)
+        {
+            std::cerr << "Failed to start the server\n";
+
+            return;
+        }
+
+        CloseWatcher watcher;
+        boost::asio::io_context client_context;
+        std::vector<boost::asio::ip::tcp::socket> sockets;
+        const boost::asio::ip::tcp::endpoint endpoint(
+            boost::asio::ip::make_address("127.0.0.1"), spec.port);
+
+        watcher.start();
+        sockets.reserve(spec.connections);
+        for (std::size_t connection = 0; connection < spec.connections; ++connection)
+        {
+            auto& socket = sockets.emplace_back(client_context);
+
+            // Every command goes out as it is written instead of waiting for
+            // the acknowledgement of the previous one.
+            socket.connect(endpoint);
+            socket.set_option(boost::asio::ip::tcp::no_delay(true));
+        }
+
+        const std::int64_t first_send = now_ns();
+        const std::uint64_t sent = send_load(spec, sockets);
+        const std::chrono::duration<double> send_time =
+            std::chrono::nanoseconds(now_ns() - first_send);
+
+        for (auto& socket : sockets)
+        {
+            socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send);
+            socket.close();
+        }
+
+        int status = 0;
+        rusage server_usage{};
+        rusage generator_usage{};
+
+        static_cast<void>(::write(done[1], &token, 1));
+        ::wait4(server_pid, &status, 0, &server_usage);
+        ::close(ready[0]);
+        ::close(done[1]);
+        watcher.stop();
+        getrusage(RUSAGE_SELF, &generator_usage);
+
+        const BlockStats stats = collect_blocks(watcher.closed());
+        const std::chrono::duration<double> total_time =
+            std::chrono::nanoseconds(stats.last_written_ns - first_send);
+
+        std::cout << "=== Performance Test: bulk_server, " << spec.connections
+                  << " connections x " << spec.commands << " commands, bulk "
+                  << spec.bulk_size << ", " << spec.threads << " threads, "
+                  << spec.dynamic_percent << "% dynamic ===\n"
+                  << std::fixed << std::setprecision(2)
+                  << std::left << std::setw(LABEL_WIDTH) << "commands sent" << sent
+                  << " in " << send_time.count() << " s\n"
+                  << std::setw(LABEL_WIDTH) << "commands written" << stats.commands
+                  << " in " << stats.latencies_ms.size() + stats.untimed_blocks
+                  << " blocks, " << stats.untimed_blocks << " without a close event\n"
+                  << std::setw(LABEL_WIDTH) << "accepted commands/s"
+                  << static_cast<double>(stats.commands) / total_time.count() << '\n'
+                  << std::setw(LABEL_WIDTH) << "block latency, ms"
+                  << "p50 " << percentile(stats.latencies_ms, P50)
+                  << "  p90 " << percentile(stats.latencies_ms, P90)
+                  << "  p99 " << percentile(stats.latencies_ms, P99)
+                  << "  max " << percentile(stats.latencies_ms, 1) << '\n'
+                  << std::setw(LABEL_WIDTH) << "peak RSS, MiB"
+                  << "server " << to_mib(server_usage.ru_maxrss)
+                  << "  load generator " << to_mib(generator_usage.ru_maxrss) << '\n';
+    }
+#endif
+} // namespace
+
+int main(int argc, char* argv[])
+{
+#if defined(__linux__)
+    const std::span<char*> arguments(argv, static_cast<std::size_t>(argc));
+    const std::filesystem::path initial_dir = std::filesystem::current_path();
+    const std::filesystem::path work_dir =
+        std::filesystem::temp_directory_path() / "bulk_server_performance_test";
+    LoadSpec spec;
+
+    for (std::size_t index = 1; index < arguments.size(); ++index)
+    {
+        if (!parse_option(arguments, index, spec))
+        {
+            std::cerr << "Usage: " << arguments[0] << " [--port <port>]"
+                " [--connections <count>] [--commands <per connection>]"
+                " [--bulk <size>] [--threads <count>] [--static-shards <count>]"
+                " [--rate <commands/s>] [--dynamic-percent <0-100>]\n";
+
+            return 1;
+        }
+    }
+
+    raise_descriptor_limit();
+    std::filesystem::remove_all(work_dir);
+    std::filesystem::create_directories(work_dir);
+    std::filesystem::current_path(work_dir);
+    run_benchmark(spec);
+    std::filesystem::current_path(initial_dir);
+    std::filesystem::remove_all(work_dir);
+#else
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+    std::cout << "The bulk_server performance test is supported only on Linux\n";
+#endif
+
+    return 0;
+}
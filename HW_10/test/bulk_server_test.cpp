@@ -1,10 +1,12 @@
 #include <charconv>
 #include <filesystem>
 #include <fstream>
+#include <latch>
 #include <regex>
 
 #include <gtest/gtest.h>
 
+#include <async_config.h>
 #include <capture.hpp>
 #include <server.hpp>
 #include <socket_wrapper.hpp>
@@ -17,6 +19,7 @@ namespace
     constexpr std::chrono::milliseconds SLEEP_BETWEEN_TESTS{1000};
     constexpr std::chrono::milliseconds SERVER_STARTUP_SLEEP_DURATION{100};
     constexpr std::uint16_t DEFAULT_PORT = 9000;
+    constexpr std::size_t POOL_THREADS = 4;
 
     void run_client_task(
         const std::string&  cmds,
@@ -107,6 +110,7 @@ class HW10 : public ::testing::Test
 {
     std::uint16_t port_{};
     std::size_t bulk_size_{};
+    std::size_t thread_count_{1};
     std::thread server_thread_;
     std::unique_ptr<async::Server> server_;
     std::exception_ptr server_exception_{nullptr};
@@ -120,7 +124,7 @@ protected:
         port_ = DEFAULT_PORT;
         bulk_size_ = 3;
 
-        server_ = std::make_unique<async::Server>(port_, bulk_size_);
+        server_ = std::make_unique<async::Server>(port_, bulk_size_, thread_count_);
         server_thread_ = std::thread([this]()
         {
             try
@@ -148,6 +152,10 @@ protected:
             server_thread_.join();
         }
 
+        // Tests that change the output settings leave the defaults behind,
+        // even when they fail halfway.
+        async::configure({});
+
         if (!HasFailure())
         {
             clear_log_files(start_time_, std::chrono::system_clock::now());
@@ -170,6 +178,8 @@ protected:
     {
         return port_;
     }
+
+    explicit HW10(const std::size_t thread_count) : thread_count_(thread_count) {}
 public:
     HW10() = default;
     HW10(const HW10&) = delete;
@@ -181,6 +191,12 @@ public:
 
 HW10::~HW10() = default;
 
+class HW10Pool : public HW10
+{
+public:
+    HW10Pool() : HW10(POOL_THREADS) {}
+};
+
 TEST_F(HW10, CombinedConnectionTest)
 {
     try
@@ -409,3 +425,215 @@ TEST_F(HW10, DynamicBlockTest)
         FAIL() << "Test failed with exception: " << e.what();
     }
 }
+
+TEST_F(HW10Pool, ManyConcurrentClients)
+{
+    try
+    {
+        constexpr int CLIENTS = 8;
+        constexpr int COMMANDS_PER_CLIENT = 30;
+        std::set<std::string> expected_cmds;
+        std::set<std::string> received_cmds;
+        std::vector<std::string> commands(CLIENTS);
+        std::vector<std::thread> clients;
+
+        for (int client = 0; client < CLIENTS; ++client)
+        {
+            for (int i = 0; i < COMMANDS_PER_CLIENT; ++i)
+            {
+                std::string command = "c";
+
+                command += std::to_string(client);
+                command += '_';
+                command += std::to_string(i);
+                commands.at(static_cast<std::size_t>(client)) += command + '\n';
+                expected_cmds.insert(command);
+            }
+        }
+
+        StdoutCapture::Begin();
+
+        for (const auto& client_commands : commands)
+        {
+            clients.emplace_back(run_client_task, client_commands, get_port());
+        }
+
+        for (auto& client : clients)
+        {
+            client.join();
+        }
+
+        std::this_thread::sleep_for(THREAD_SLEEP_DURATION);
+
+        std::stringstream output(StdoutCapture::End());
+        std::string line;
+
+        while (std::getline(output, line))
+        {
+            std::stringstream words(line);
+            std::string word;
+            std::size_t block_size = 0;
+
+            words >> word;
+            ASSERT_EQ(word, "bulk:");
+            while (words >> word)
+            {
+                std::erase(word, ',');
+                received_cmds.insert(word);
+                ++block_size;
+            }
+
+            ASSERT_LE(block_size, 3U);
+        }
+
+        ASSERT_EQ(received_cmds, expected_cmds);
+    }
+    catch (const std::exception& e)
+    {
+        FAIL() << "Test failed with exception: " << e.what();
+    }
+}
+
+TEST_F(HW10Pool, UnterminatedLastLines)
+{
+    try
+    {
+        constexpr std::size_t CLIENTS = 16;
+        std::set<std::string> expected_cmds;
+        std::set<std::string> received_cmds;
+        std::vector<std::unique_ptr<test_util::ClientSocket>> sockets;
+        std::vector<std::thread> clients;
+        std::latch ready(static_cast<std::ptrdiff_t>(CLIENTS));
+
+        StdoutCapture::Begin();
+
+        for (std::size_t client = 0; client < CLIENTS; ++client)
+        {
+            sockets.emplace_back(
+                std::make_unique<test_util::ClientSocket>("127.0.0.1", get_port()));
+        }
+
+        // The last command of every client has no newline, so every closing
+        // session still flushes a command while the others close too.
+        for (std::size_t client = 0; client < CLIENTS; ++client)
+        {
+            std::string first = "u";
+            std::string commands;
+
+            first += std::to_string(client);
+            commands += first;
+            commands += "_0\n";
+            commands += first;
+            commands += "_1";
+            expected_cmds.insert(first + "_0");
+            expected_cmds.insert(first + "_1");
+            clients.emplace_back([&socket = *sockets.at(client), &ready, commands]()
+            {
+                ready.arrive_and_wait();
+                socket.send_data(commands);
+            });
+        }
+
+        for (auto& client : clients)
+        {
+            client.join();
+        }
+
+        sockets.clear();
+        std::this_thread::sleep_for(THREAD_SLEEP_DURATION);
+
+        std::stringstream output(StdoutCapture::End());
+        std::string line;
+
+        while (std::getline(output, line))
+        {
+            std::stringstream words(line);
+            std::string word;
+
+            words >> word;
+            ASSERT_EQ(word, "bulk:");
+            while (words >> word)
+            {
+                std::erase(word, ',');
+                received_cmds.insert(word);
+            }
+        }
+
+        ASSERT_EQ(received_cmds, expected_cmds);
+    }
+    catch (const std::exception& e)
+    {
+        FAIL() << "Test failed with exception: " << e.what();
+    }
+}
+
+TEST_F(HW10Pool, RelaxedStaticShards)
+{
+    try
+    {
+        constexpr int COMMANDS_PER_CLIENT = 30;
+        const std::array<std::string, 2> prefixes = {"a", "b"};
+        std::array<std::string, 2> commands;
+        std::set<std::string> expected_cmds;
+        std::set<std::string> received_cmds;
+        std::vector<std::thread> clients;
+
+        async::config settings;
+        settings.mixing = async::static_mixing::relaxed;
+        settings.static_shards = 2;
+        async::configure(settings);
+
+        for (std::size_t client = 0; client < prefixes.size(); ++client)
+        {
+            for (int i = 0; i < COMMANDS_PER_CLIENT; ++i)
+            {
+                const std::string command = prefixes.at(client) + std::to_string(i);
+
+                commands.at(client) += command + '\n';
+                expected_cmds.insert(command);
+            }
+        }
+
+        StdoutCapture::Begin();
+
+        for (const auto& client_commands : commands)
+        {
+            clients.emplace_back(run_client_task, client_commands, get_port());
+        }
+
+        for (auto& client : clients)
+        {
+            client.join();
+        }
+
+        std::this_thread::sleep_for(THREAD_SLEEP_DURATION);
+
+        std::stringstream output(StdoutCapture::End());
+        std::string line;
+
+        while (std::getline(output, line))
+        {
+            std::stringstream words(line);
+            std::string word;
+            std::set<char> sources;
+
+            words >> word;
+            ASSERT_EQ(word, "bulk:");
+            while (words >> word)
+            {
+                std::erase(word, ',');
+                received_cmds.insert(word);
+                sources.insert(word.front());
+            }
+
+            // The two connections are on different shards.
+            ASSERT_EQ(sources.size(), 1U);
+        }
+
+        ASSERT_EQ(received_cmds, expected_cmds);
+    }
+    catch (const std::exception& e)
+    {
+        FAIL() << "Test failed with exception: " << e.what();
+    }
+}
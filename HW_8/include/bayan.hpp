@@ -5,17 +5,15 @@
  || __GNUC__ < 14
 #include <cstdint>
 #endif
-#if defined(_MSC_VER) && !defined(__clang__) && !defined(__INTEL_COMPILER)
 #include <functional>
-#endif
 #include <fstream>
-#include <regex>
 #if defined(_MSC_VER) && !defined(__clang__) && !defined(__INTEL_COMPILER)\
  || defined(__clang__)\
  || __GNUC__ < 14
 #include <span>
 #endif
 #include <unordered_map>
+#include <vector>
 
 std::string compute_crc32(std::string_view input);
 std::string compute_md5(std::string_view input);
@@ -33,6 +31,11 @@ struct HashAlgorithm
     explicit HashAlgorithm(std::string_view name);
 
     [[nodiscard]] std::string compute_hash(std::string_view input) const;
+    [[nodiscard]] hash_algorithm get_value() const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
 
 private:
     hash_algorithm value_;
@@ -48,11 +51,6 @@ private:
     };
 };
 
-struct BlockSize
-{
-    uintmax_t value;
-};
-
 struct MinFileSize
 {
     uintmax_t value;
@@ -73,6 +71,11 @@ struct ScanDirs
     std::vector<std::string> value;
 };
 
+struct ThreadCount
+{
+    std::size_t value;
+};
+
 enum class ProcessStatus : std::uint8_t
 {
     SUCCESS = 0,
@@ -81,19 +84,63 @@ enum class ProcessStatus : std::uint8_t
     FILE_ERROR = 3,
 };
 
+enum class output_format : std::uint8_t
+{
+    text,
+    ndjson,
+};
+
+enum class dedup_action : std::uint8_t
+{
+    none,
+    hardlink,
+    reflink,
+    remove,
+};
+
+enum class keep_policy : std::uint8_t
+{
+    first_scan_dir,
+    oldest,
+    shortest_path,
+};
+
+enum class io_backend : std::uint8_t
+{
+    automatic,
+    io_uring,
+    threads,
+};
+
 struct Options
 {
     bool scan_level{};
+    bool report_hardlinks{};
+    bool stats{};
+    bool watch{};
+    bool print0{};
+    bool verify{};
+    bool dry_run{};
+    output_format format{output_format::text};
+    dedup_action action{dedup_action::none};
+    keep_policy keep{keep_policy::first_scan_dir};
+    io_backend io{io_backend::automatic};
     HashAlgorithm hash_algorithm;
     std::vector<std::string> exclude_dirs;
     std::vector<std::string> file_masks;
     std::vector<std::string> scan_dirs;
+    std::string cache_path;
     uintmax_t block_size{};
     uintmax_t min_file_size{};
+    uintmax_t similar_bytes{};
+    std::size_t threads{};
 };
 
 std::pair<ProcessStatus, Options> option_process(std::span<const char *const> argv);
 
 ProcessStatus process_files(const Options& options);
 
+// Escapes a string for use inside a JSON string literal.
+std::string json_escape(std::string_view value);
+
 #endif // BAYAN_HPP
@@ -0,0 +1,78 @@
+#ifndef BLOCK_PIPELINE_HPP
+#define BLOCK_PIPELINE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <bayan.hpp>
+#include <descriptor_pool.hpp>
+#include <file_table.hpp>
+
+class WorkerPool;
+class UringQueue;
+
+// Reads and hashes blocks of many files at once, so the device sees a deep
+// queue instead of one synchronous read at a time. Reads go through io_uring
+// when the kernel allows it and through a pool of pread() threads otherwise.
+class BlockPipeline
+{
+public:
+    struct Request
+    {
+        FileTable::Index file;
+        std::uint64_t offset;
+        std::string* digest;
+    };
+private:
+    void run_batch(std::span<const Request> batch);
+
+    const FileTable& table_;
+    HashAlgorithm hash_algo_;
+    std::size_t block_size_;
+    std::size_t queue_depth_;
+    io_backend backend_{io_backend::threads};
+    DescriptorPool descriptors_{DescriptorPool::DEFAULT_CAPACITY};
+    std::vector<char> buffers_;
+    std::vector<std::size_t> lengths_;
+    std::unique_ptr<UringQueue> uring_;
+    std::unique_ptr<WorkerPool> workers_;
+    std::uint64_t bytes_read_{0};
+public:
+    BlockPipeline(
+        const FileTable& table,
+        HashAlgorithm    hash_algo,
+        std::size_t      block_size,
+        io_backend       backend,
+        ThreadCount      threads);
+    BlockPipeline(const BlockPipeline&) = delete;
+    BlockPipeline(BlockPipeline&&) = delete;
+    BlockPipeline& operator=(const BlockPipeline&) = delete;
+    BlockPipeline& operator=(BlockPipeline&&) = delete;
+    ~BlockPipeline();
+
+    // Stores the digest of every requested block. Each file may appear in a
+    // call at most once.
+    void run(std::span<const Request> requests);
+    void release(FileTable::Index file);
+
+    [[nodiscard]] io_backend backend() const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] std::size_t queue_depth() const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] std::uint64_t bytes_read() const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+};
+
+#endif // BLOCK_PIPELINE_HPP
@@ -0,0 +1,76 @@
+#ifndef CHUNK_INDEX_HPP
+#define CHUNK_INDEX_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <bayan.hpp>
+#include <file_table.hpp>
+
+// FastCDC-style content-defined chunking: cut points depend only on the bytes
+// around them, so an insertion shifts at most the chunks it touches.
+class ContentChunker
+{
+public:
+    static constexpr std::size_t MIN_SIZE = 2 * 1024;
+    static constexpr std::size_t AVERAGE_SIZE = 8 * 1024;
+    static constexpr std::size_t MAX_SIZE = 64 * 1024;
+
+    // Returns the length of the first chunk of data. A chunk shorter than
+    // MAX_SIZE is only final if data holds the rest of the file.
+    [[nodiscard]] static std::size_t next_cut(std::span<const char> data)
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+};
+
+struct SimilarPair
+{
+    FileTable::Index first;
+    FileTable::Index second;
+    std::uint64_t shared_bytes;
+};
+
+class ChunkIndex
+{
+    struct Chunk
+    {
+        std::uint64_t digest;
+        FileTable::Index file;
+        std::uint32_t size;
+    };
+
+    void chunk_file(
+        FileTable::Index    file,
+        std::vector<Chunk>& chunks,
+        std::vector<char>&  buffer);
+
+    const FileTable& table_;
+    std::size_t threads_;
+    std::vector<Chunk> chunks_;
+    std::atomic<std::uint64_t> bytes_read_{0};
+public:
+    // Chunks shared by more files than this are ignored when pairing files:
+    // they are typically runs of zeros or common headers and would produce a
+    // quadratic number of pairs.
+    static constexpr std::size_t MAX_FILES_PER_CHUNK = 256;
+
+    ChunkIndex(
+        const FileTable& table,
+        ThreadCount      threads);
+
+    void add_files(std::span<const FileTable::Index> files);
+
+    [[nodiscard]] std::vector<SimilarPair> similar_pairs(std::uint64_t min_shared) const;
+    [[nodiscard]] std::size_t chunk_count() const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] std::uint64_t bytes_read() const;
+};
+
+#endif // CHUNK_INDEX_HPP
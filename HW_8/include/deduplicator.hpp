@@ -0,0 +1,44 @@
+#ifndef DEDUPLICATOR_HPP
+#define DEDUPLICATOR_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <bayan.hpp>
+#include <file_table.hpp>
+
+class Deduplicator
+{
+    [[nodiscard]] FileTable::Index select_keeper(
+        std::span<const FileTable::Index> group) const;
+    [[nodiscard]] std::size_t scan_dir_index(FileTable::Index file) const;
+    [[nodiscard]] bool is_unchanged(FileTable::Index file) const;
+    bool apply(
+        FileTable::Index keeper,
+        FileTable::Index target);
+
+    const FileTable& table_;
+    dedup_action action_;
+    keep_policy keep_;
+    bool dry_run_;
+    std::vector<std::string> scan_dirs_;
+    std::uint64_t bytes_reclaimed_{0};
+    bool failed_{false};
+public:
+    Deduplicator(
+        const Options&   options,
+        const FileTable& table);
+
+    void process(std::span<const FileTable::Index> group);
+    void finish() const;
+
+    [[nodiscard]] bool failed() const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+};
+
+#endif // DEDUPLICATOR_HPP
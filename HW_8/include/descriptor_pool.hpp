@@ -0,0 +1,68 @@
+#ifndef DESCRIPTOR_POOL_HPP
+#define DESCRIPTOR_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#if defined(_WIN32)
+#include <fstream>
+#endif
+
+#include <wrapper_boost_filesystem.hpp>
+
+#if !defined(_WIN32)
+// pread() until the buffer is full or the file ends, retrying on EINTR.
+std::size_t read_at(
+    int             descriptor,
+    std::uint64_t   offset,
+    std::span<char> buffer);
+#endif
+
+class DescriptorPool
+{
+    struct Slot
+    {
+        std::uint64_t last_use;
+#if defined(_WIN32)
+        std::ifstream stream;
+#else
+        int descriptor;
+#endif
+    };
+
+    void evict();
+
+    std::size_t capacity_;
+    std::uint64_t clock_{0};
+    std::unordered_map<std::size_t, Slot> slots_;
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 256;
+
+    explicit DescriptorPool(std::size_t capacity);
+    DescriptorPool(const DescriptorPool&) = delete;
+    DescriptorPool(DescriptorPool&&) = delete;
+    DescriptorPool& operator=(const DescriptorPool&) = delete;
+    DescriptorPool& operator=(DescriptorPool&&) = delete;
+    ~DescriptorPool();
+
+    [[nodiscard]] bool contains(std::size_t owner) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    void open(
+        std::size_t                    owner,
+        const boost::filesystem::path& path);
+    std::size_t read(
+        std::size_t     owner,
+        std::uint64_t   offset,
+        std::span<char> buffer);
+#if !defined(_WIN32)
+    [[nodiscard]] int descriptor(std::size_t owner) const;
+#endif
+    void release(std::size_t owner);
+    void clear();
+};
+
+#endif // DESCRIPTOR_POOL_HPP
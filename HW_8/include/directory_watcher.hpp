@@ -0,0 +1,69 @@
+#ifndef DIRECTORY_WATCHER_HPP
+#define DIRECTORY_WATCHER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+
+#include <bayan.hpp>
+#include <duplicate_index.hpp>
+#include <path_filter.hpp>
+
+class DirectoryWatcher
+{
+    void add_watch(
+        const boost::filesystem::path&       dir,
+        bool                                 index_files,
+        std::vector<DuplicateIndex::Change>& changes);
+    void add_link_watch(
+        const boost::filesystem::path&       link,
+        bool                                 index_files,
+        std::vector<DuplicateIndex::Change>& changes);
+    void remove_watch(const boost::filesystem::path& dir);
+    void update_file(
+        const boost::filesystem::path&       path,
+        std::vector<DuplicateIndex::Change>& changes);
+    void handle_event(
+        int                                  watch,
+        std::uint32_t                        mask,
+        std::string_view                     name,
+        std::vector<DuplicateIndex::Change>& changes);
+    [[nodiscard]] bool is_excluded(const boost::filesystem::path& dir) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+
+    void print_changes(const std::vector<DuplicateIndex::Change>& changes) const;
+
+    DuplicateIndex& index_;
+    GlobMatcher file_masks_;
+    ExcludeTrie exclude_dirs_;
+    std::vector<std::string> scan_dirs_;
+    uintmax_t min_file_size_;
+    bool scan_level_;
+    output_format format_;
+    char separator_;
+    std::unordered_map<int, boost::filesystem::path> watches_;
+    std::map<std::pair<std::uint64_t, std::uint64_t>, boost::filesystem::path>
+        linked_dirs_;
+    int inotify_fd_{-1};
+    std::atomic<bool> stopped_{false};
+public:
+    DirectoryWatcher(
+        const Options&  options,
+        DuplicateIndex& index);
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher(DirectoryWatcher&&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(DirectoryWatcher&&) = delete;
+    ~DirectoryWatcher();
+
+    ProcessStatus run();
+    void stop() noexcept;
+    void setup_signal_handling();
+};
+
+#endif // DIRECTORY_WATCHER_HPP
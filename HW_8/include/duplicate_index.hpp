@@ -0,0 +1,78 @@
+#ifndef DUPLICATE_INDEX_HPP
+#define DUPLICATE_INDEX_HPP
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <bayan.hpp>
+#include <file_table.hpp>
+#include <wrapper_boost_filesystem.hpp>
+
+class DuplicateFinder;
+
+class DuplicateIndex
+{
+public:
+    struct Change
+    {
+        bool formed;
+        std::vector<std::string> paths;
+    };
+private:
+    struct SizeClass
+    {
+        std::vector<FileTable::Index> files;
+        std::set<std::vector<std::string>> groups;
+    };
+
+    FileTable::Index add_path(
+        const boost::filesystem::path& path,
+        uintmax_t                      size);
+    void register_file(FileTable::Index file);
+    std::optional<uintmax_t> erase(const std::string& path);
+    void compact();
+    void refresh(
+        uintmax_t            size,
+        std::vector<Change>& changes);
+
+    FileTable table_;
+    std::unique_ptr<DuplicateFinder> finder_;
+    std::map<uintmax_t, SizeClass> size_classes_;
+    std::unordered_map<std::string, FileTable::Index> files_;
+    std::unordered_map<std::string, FileTable::Index> directories_;
+    std::size_t removed_{0};
+public:
+    DuplicateIndex(
+        HashAlgorithm hash_algo,
+        std::size_t   block_size);
+    DuplicateIndex(const DuplicateIndex&) = delete;
+    DuplicateIndex(DuplicateIndex&&) = delete;
+    DuplicateIndex& operator=(const DuplicateIndex&) = delete;
+    DuplicateIndex& operator=(DuplicateIndex&&) = delete;
+    ~DuplicateIndex();
+
+    void load(
+        FileTable                         table,
+        std::span<const FileTable::Index> files);
+    std::vector<Change> refresh_all();
+
+    std::vector<Change> add(
+        const boost::filesystem::path& path,
+        uintmax_t                      size);
+    std::vector<Change> remove(const boost::filesystem::path& path);
+    std::vector<Change> remove_directory(const boost::filesystem::path& dir);
+
+    [[nodiscard]] std::size_t size() const noexcept
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+};
+
+#endif // DUPLICATE_INDEX_HPP
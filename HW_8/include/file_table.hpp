@@ -0,0 +1,125 @@
+#ifndef FILE_TABLE_HPP
+#define FILE_TABLE_HPP
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <hash_cache.hpp>
+#include <wrapper_boost_filesystem.hpp>
+
+class FileTable
+{
+public:
+    using Index = std::uint32_t;
+
+    static constexpr Index NO_INDEX = std::numeric_limits<Index>::max();
+private:
+    static constexpr std::uint8_t HAS_KEY = 1U;
+    static constexpr std::uint8_t IS_LINK = 2U;
+    static constexpr std::uint8_t REMOVED = 4U;
+    static constexpr std::uint8_t IS_SYMLINK = 8U;
+
+    struct Entry
+    {
+        Index index;
+        bool is_directory;
+    };
+
+    std::uint32_t intern_name(std::string_view name);
+    [[nodiscard]] std::string_view entry_name(const Entry& entry) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+
+    std::string names_;
+    std::vector<Index> directory_parent_;
+    std::vector<std::uint32_t> directory_name_offset_;
+    std::vector<std::uint32_t> directory_name_length_;
+    std::vector<Index> file_directory_;
+    std::vector<std::uint32_t> file_name_offset_;
+    std::vector<std::uint16_t> file_name_length_;
+    std::vector<std::uint64_t> file_size_;
+    std::vector<std::uint64_t> device_;
+    std::vector<std::uint64_t> inode_;
+    std::vector<std::int64_t> mtime_ns_;
+    std::vector<std::uint8_t> flags_;
+    std::vector<Index> next_link_;
+    std::vector<Index> digest_slot_;
+    std::vector<std::vector<std::string>> digests_;
+    std::vector<Index> free_digest_slots_;
+public:
+    Index add_directory(
+        Index            parent,
+        std::string_view name);
+    Index add_file(
+        Index            directory,
+        std::string_view name,
+        std::uint64_t    size);
+    void set_key(
+        Index          file,
+        const FileKey& key);
+    void add_link(
+        Index file,
+        Index link);
+    void mark_symlink(Index file);
+    void unlink(Index file);
+    void remove(Index file);
+
+    [[nodiscard]] std::size_t size() const noexcept
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] boost::filesystem::path path(Index file) const;
+    [[nodiscard]] boost::filesystem::path directory_path(Index directory) const;
+    [[nodiscard]] std::uint64_t file_size(Index file) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] std::optional<FileKey> key(Index file) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] Index next_link(Index file) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] bool is_link(Index file) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] bool is_removed(Index file) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] bool is_symlink(Index file) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+
+    std::span<std::string> digests(
+        Index       file,
+        std::size_t block_count);
+    [[nodiscard]] std::span<const std::string> find_digests(Index file) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    void release_digests(Index file);
+
+    [[nodiscard]] std::vector<Index> sorted_files() const;
+};
+
+#endif // FILE_TABLE_HPP
@@ -0,0 +1,56 @@
+#ifndef GROUP_VERIFIER_HPP
+#define GROUP_VERIFIER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include <bayan.hpp>
+#include <descriptor_pool.hpp>
+#include <file_table.hpp>
+
+class GroupVerifier
+{
+public:
+    using GroupHandler = std::function<void(std::span<const FileTable::Index>)>;
+private:
+    struct Reader
+    {
+        DescriptorPool descriptors{DescriptorPool::DEFAULT_CAPACITY};
+        std::vector<char> representative;
+        std::vector<char> member;
+    };
+
+    void flush();
+    std::vector<std::vector<FileTable::Index>> verify_group(
+        const std::vector<FileTable::Index>& group,
+        Reader&                              reader);
+    std::vector<FileTable::Index> split_group(
+        std::vector<FileTable::Index>& group,
+        Reader&                        reader);
+    std::size_t read_chunk(
+        FileTable::Index   file,
+        std::uint64_t      offset,
+        std::vector<char>& buffer,
+        Reader&            reader);
+
+    const FileTable& table_;
+    GroupHandler on_group_;
+    std::size_t threads_;
+    std::vector<std::vector<FileTable::Index>> pending_;
+    std::atomic<std::uint64_t> bytes_read_{0};
+public:
+    GroupVerifier(
+        const FileTable& table,
+        ThreadCount      threads,
+        GroupHandler     on_group);
+
+    void add(std::span<const FileTable::Index> group);
+    void finish();
+
+    [[nodiscard]] std::uint64_t bytes_read() const;
+};
+
+#endif // GROUP_VERIFIER_HPP
@@ -0,0 +1,79 @@
+#ifndef HASH_CACHE_HPP
+#define HASH_CACHE_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <bayan.hpp>
+#include <wrapper_boost_filesystem.hpp>
+
+struct FileKey
+{
+    std::uint64_t device{};
+    std::uint64_t inode{};
+    std::uint64_t size{};
+    std::int64_t mtime_ns{};
+};
+
+std::optional<FileKey> query_file_key(const boost::filesystem::path& path);
+
+class HashCache
+{
+    struct EntryKey
+    {
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::uint64_t block_size;
+        hash_algorithm algorithm;
+
+        bool operator==(const EntryKey& other) const = default;
+    };
+
+    struct EntryKeyHash
+    {
+        std::size_t operator()(const EntryKey& key) const noexcept
+#ifndef _MSC_VER
+            __attribute__((pure))
+#endif
+            ;
+    };
+
+    struct Entry
+    {
+        std::uint64_t size;
+        std::int64_t mtime_ns;
+        std::vector<std::string> hashes;
+        // Set once the entry is looked up or stored, so that save() drops the
+        // entries of files that were deleted, changed or not scanned.
+        mutable bool used{false};
+    };
+
+    std::string path_;
+    std::uint64_t block_size_;
+    hash_algorithm algorithm_;
+    std::unordered_map<EntryKey, Entry, EntryKeyHash> entries_;
+public:
+    HashCache(
+        std::string    path,
+        std::uint64_t  block_size,
+        hash_algorithm algorithm);
+
+    bool load();
+    [[nodiscard]] bool save() const;
+
+    [[nodiscard]] const std::vector<std::string>* find(const FileKey& key) const;
+    void store(
+        const FileKey&           key,
+        std::vector<std::string> hashes);
+
+    [[nodiscard]] std::size_t size() const noexcept
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+};
+
+#endif // HASH_CACHE_HPP
@@ -0,0 +1,89 @@
+#ifndef PATH_FILTER_HPP
+#define PATH_FILTER_HPP
+
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <wrapper_boost_filesystem.hpp>
+
+class GlobMatcher
+{
+    struct Pattern
+    {
+        std::vector<std::string> segments;
+    };
+
+    static bool matches_segment(
+        std::string_view segment,
+        std::string_view text)
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    static bool matches_pattern(
+        const Pattern&   pattern,
+        std::string_view name)
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+
+    std::vector<Pattern> patterns_;
+public:
+    explicit GlobMatcher(const std::vector<std::string>& masks);
+
+    [[nodiscard]] bool matches(std::string_view name) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+};
+
+class ExcludeTrie
+{
+    struct Node
+    {
+        std::map<std::string, std::size_t, std::less<>> children;
+        bool excluded{false};
+    };
+
+    void insert(const boost::filesystem::path& path);
+
+    std::vector<Node> nodes_;
+public:
+    static constexpr std::size_t NO_NODE = std::numeric_limits<std::size_t>::max();
+
+    explicit ExcludeTrie(const std::vector<std::string>& exclude_dirs);
+
+    [[nodiscard]] std::size_t find(const boost::filesystem::path& path) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] std::size_t descend(
+        std::size_t      node,
+        std::string_view component) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] bool is_excluded(std::size_t node) const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+};
+
+[[nodiscard]] bool is_inside_directory(
+    std::string_view path,
+    std::string_view dir)
+#ifndef _MSC_VER
+    __attribute__((pure))
+#endif
+    ;
+
+#endif // PATH_FILTER_HPP
@@ -1,100 +1,205 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <utility>
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
 
 #include <bayan.hpp>
+#include <block_pipeline.hpp>
+#include <chunk_index.hpp>
+#include <deduplicator.hpp>
+#include <descriptor_pool.hpp>
+#include <directory_watcher.hpp>
+#include <duplicate_index.hpp>
+#include <file_table.hpp>
+#include <group_verifier.hpp>
+#include <hash_cache.hpp>
+#include <path_filter.hpp>
 #include <wrapper_boost_algorithm_hex.hpp>
 #include <wrapper_boost_crc.hpp>
 #include <wrapper_boost_filesystem.hpp>
 #include <wrapper_boost_program_options.hpp>
 #include <wrapper_boost_uuid_detail_md5.hpp>
 
-struct FileInfo
+namespace
 {
-    FileInfo(
-        boost::filesystem::path path,
-        uintmax_t               size,
-        std::size_t             block_size);
+    std::size_t resolve_thread_count(const std::size_t requested)
+    {
+        if (requested != 0)
+        {
+            return requested;
+        }
 
-    FileInfo(const FileInfo& other);
-    FileInfo(FileInfo&&) noexcept = default;
-    FileInfo& operator=(const FileInfo& other);
-    FileInfo& operator=(FileInfo&&) noexcept = default;
+        return std::max(1U, std::thread::hardware_concurrency());
+    }
 
-    ~FileInfo() noexcept;
+    std::vector<std::size_t> block_visit_order(const std::size_t num_blocks)
+    {
+        constexpr std::size_t MIDDLE_SAMPLES = 3;
+        std::vector<std::size_t> order;
+        std::vector<bool> visited(num_blocks, false);
+        const auto visit = [&order, &visited](const std::size_t block_index)
+        {
+            if (!visited[block_index])
+            {
+                visited[block_index] = true;
+                order.emplace_back(block_index);
+            }
+        };
 
-    [[nodiscard]] uintmax_t get_size() const
-#ifndef _MSC_VER
-        __attribute__((pure))
-#endif
-        ;
-    [[nodiscard]] const std::vector<std::string>& get_hashes() const
-#ifndef _MSC_VER
-        __attribute__((const))
-#endif
-        ;
-    const boost::filesystem::path& get_path() const
-#ifndef _MSC_VER
-        __attribute__((const))
-#endif
-        ;
-    std::string compute_block_hash(
-        std::size_t          block_index,
-        const HashAlgorithm& hash_algo) const;
+        if (num_blocks == 0)
+        {
+            return order;
+        }
 
-private:
-    void open_file() const;
-    void close_file() const;
-
-    boost::filesystem::path path_;
-    mutable bool file_opened{false};
-    mutable std::ifstream file_stream;
-    mutable std::vector<std::string> hashes;
-    std::size_t block_size_;
-    uintmax_t size_;
-};
+        order.reserve(num_blocks);
+        visit(0);
+        visit(num_blocks - 1);
+        for (std::size_t sample = 1; sample <= MIDDLE_SAMPLES; ++sample)
+        {
+            visit(num_blocks * sample / (MIDDLE_SAMPLES + 1));
+        }
+
+        for (std::size_t block_index = 0; block_index < num_blocks; ++block_index)
+        {
+            visit(block_index);
+        }
+
+        return order;
+    }
+} // namespace
 
 class FileScanner
 {
+#if defined(__linux__)
+    struct Subdirectory
+    {
+        boost::filesystem::path path;
+        std::uint64_t device;
+        std::uint64_t inode;
+        bool via_symlink;
+        std::size_t exclude_node;
+        FileTable::Index directory;
+    };
+
+    struct ScannedFile
+    {
+        std::string name;
+        FileKey key;
+        bool symlink;
+    };
+
+    void scan_directories_parallel(
+        const std::vector<boost::filesystem::path>& dirs,
+        FileTable&                                  table) const;
+    void scan_single_directory(
+        const Subdirectory&            dir,
+        std::vector<ScannedFile>&      files,
+        std::vector<Subdirectory>&     subdirs,
+        std::string&                   error) const;
+#else
     void scan_directory_recursive(
         const boost::filesystem::path& dir,
-        std::vector<FileInfo>&         files);
+        FileTable&                     table);
     void scan_directory_non_recursive(
         const boost::filesystem::path& dir,
-        std::vector<FileInfo>&         files);
-    [[nodiscard]] bool matches_masks(const boost::filesystem::path& file_path) const;
-    [[nodiscard]] bool is_excluded(const boost::filesystem::path& dir) const;
+        FileTable&                     table);
+    void add_scanned_file(
+        const boost::filesystem::path& path,
+        uintmax_t                      size,
+        FileTable&                     table);
+
+    std::unordered_map<std::string, FileTable::Index> directories_;
+#endif
+    static void collapse_hard_links(
+        FileTable&                     table,
+        std::vector<FileTable::Index>& files);
 
     bool scan_level_;
-    std::vector<std::regex> mask_regexes_;
-    std::vector<std::string> exclude_dirs_;
-    std::vector<std::string> file_masks_;
+    GlobMatcher file_masks_;
+    ExcludeTrie exclude_dirs_;
     std::vector<std::string> scan_dirs_;
-    uintmax_t block_size_;
     uintmax_t min_file_size_;
+    std::size_t threads_;
 public:
     FileScanner(
         bool               scan_level,
-        BlockSize          block_size,
         MinFileSize        min_file_size,
         const ExcludeDirs& exclude_dirs,
         const FileMasks&   file_masks,
-        const ScanDirs&    scan_dirs);
+        const ScanDirs&    scan_dirs,
+        ThreadCount        threads);
 
-    std::vector<FileInfo> scan_directories();
+    std::vector<FileTable::Index> scan_directories(FileTable& table);
 };
 
 class DuplicateFinder
 {
-    std::vector<std::vector<FileInfo>>
-        find_duplicates_in_group(std::vector<FileInfo*>& files);
+public:
+    using GroupHandler = std::function<void(std::span<const FileTable::Index>)>;
+private:
+    // Files of one size that may still be duplicates, and the next block to
+    // compare them by.
+    struct SizeClass
+    {
+        std::vector<FileTable::Index> files;
+        std::vector<FileTable::Index> hard_linked;
+        std::vector<std::size_t> block_order;
+        std::size_t num_blocks{0};
+        std::size_t next_block{0};
+
+        [[nodiscard]] bool finished() const
+        {
+            return files.size() < 2 || next_block == block_order.size();
+        }
+    };
+
+    void start_size_class(SizeClass& size_class);
+    void compare_next_blocks(std::deque<SizeClass>& size_classes);
+    void report_size_class(
+        SizeClass&          size_class,
+        const GroupHandler& on_group);
+    void load_cached_hashes(
+        FileTable::Index file,
+        std::size_t      num_blocks);
 
-    HashAlgorithm hash_algo_;
+    FileTable& table_;
     uintmax_t block_size_;
+    const HashCache* cache_{nullptr};
+    BlockPipeline pipeline_;
 public:
     DuplicateFinder(
+        FileTable&    table,
         HashAlgorithm hash_algo,
-        uintmax_t     block_size);
+        uintmax_t     block_size,
+        io_backend    backend,
+        ThreadCount   threads);
 
-    std::vector<std::vector<FileInfo>> find_duplicates(std::vector<FileInfo>& files);
+    void use_cache(const HashCache& cache);
+    void find_duplicates(
+        std::span<const FileTable::Index> files,
+        const GroupHandler&               on_group);
+
+    [[nodiscard]] std::uint64_t bytes_read() const
+#ifndef _MSC_VER
+        __attribute__((pure))
+#endif
+        ;
+    [[nodiscard]] const BlockPipeline& pipeline() const
+#ifndef _MSC_VER
+        __attribute__((const))
+#endif
+        ;
 };
 
 std::string compute_crc32(std::string_view input)
@@ -176,160 +281,233 @@ std::string HashAlgorithm::compute_hash(std::string_view input) const
     return hash_function(input);
 }
 
-FileInfo::FileInfo(
-    boost::filesystem::path path,
-    const uintmax_t         size,
-    const std::size_t       block_size)
-    :
-    path_(std::move(path)),
-    hashes((size + block_size - 1) / block_size),
-    block_size_(block_size),
-    size_(size) {}
+hash_algorithm HashAlgorithm::get_value() const
+{
+    return value_;
+}
 
-FileInfo::FileInfo(const FileInfo& other)
+FileScanner::FileScanner(
+    const bool         scan_level,
+    const MinFileSize  min_file_size,
+    const ExcludeDirs& exclude_dirs,
+    const FileMasks&   file_masks,
+    const ScanDirs&    scan_dirs,
+    const ThreadCount  threads)
     :
-    path_(other.path_),
-    hashes(other.hashes),
-    block_size_(other.block_size_),
-    size_(other.size_) {}
+    scan_level_(scan_level),
+    file_masks_(file_masks.value),
+    exclude_dirs_(exclude_dirs.value),
+    scan_dirs_(scan_dirs.value),
+    min_file_size_(min_file_size.value),
+    threads_(resolve_thread_count(threads.value)) {}
 
-FileInfo& FileInfo::operator=(const FileInfo& other)
+#if defined(__linux__)
+void FileScanner::scan_directories_parallel(
+    const std::vector<boost::filesystem::path>& dirs,
+    FileTable&                                  table) const
 {
-    if (this != &other)
-    {
-        close_file();
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Subdirectory> pending;
+    std::set<std::pair<std::uint64_t, std::uint64_t>> visited_links;
+    std::size_t active = 0;
 
-        path_ = other.path_;
-        hashes = other.hashes;
-        size_ = other.size_;
-        block_size_ = other.block_size_;
-        file_opened = false;
+    for (const auto& dir : dirs)
+    {
+        pending.emplace_back(Subdirectory{dir, 0, 0, false, exclude_dirs_.find(dir),
+            table.add_directory(FileTable::NO_INDEX, dir.string())});
     }
 
-    return *this;
-}
-
-FileInfo::~FileInfo() noexcept
-{
-    close_file();
-}
-
-uintmax_t FileInfo::get_size() const
-{
-    return size_;
-}
+    const auto worker = [&]()
+    {
+        std::vector<ScannedFile> found;
+        std::vector<Subdirectory> subdirs;
+        std::string error;
+        std::unique_lock<std::mutex> lock(mutex);
 
-const std::vector<std::string>& FileInfo::get_hashes() const
-{
-    return hashes;
-}
+        while (true)
+        {
+            condition.wait(lock, [&pending, &active]() noexcept
+            {
+                return !pending.empty() || active == 0;
+            });
 
-const boost::filesystem::path& FileInfo::get_path() const
-{
-    return path_;
-}
+            if (pending.empty())
+            {
+                break;
+            }
 
-std::string FileInfo::compute_block_hash(
-    const std::size_t    block_index,
-    const HashAlgorithm& hash_algo) const
-{
-    std::vector<char> buffer(block_size_, 0);
+            const Subdirectory dir = std::move(pending.front());
+            pending.pop_front();
+            ++active;
+            lock.unlock();
 
-    if (!hashes[block_index].empty())
-    {
-        return hashes[block_index];
-    }
+            scan_single_directory(dir, found, subdirs, error);
 
-    if (!file_opened)
-    {
-        open_file();
-    }
+            lock.lock();
+            --active;
+            if (!error.empty())
+            {
+                std::cerr << "Error scanning directory " << dir.path << ": " << error
+                    << '\n';
+                error.clear();
+            }
 
-    file_stream.seekg(static_cast<std::streamoff>(block_index * block_size_));
-    file_stream.read(buffer.data(), static_cast<std::streamsize>(block_size_));
+            for (const auto& file : found)
+            {
+                const FileTable::Index index =
+                    table.add_file(dir.directory, file.name, file.key.size);
 
-    const std::streamsize bytes_read = file_stream.gcount();
+                table.set_key(index, file.key);
+                if (file.symlink)
+                {
+                    table.mark_symlink(index);
+                }
+            }
 
-    const std::string block_data(buffer.data(),
-        static_cast<std::string::size_type>(bytes_read));
+            for (auto& subdir : subdirs)
+            {
+                if (  !subdir.via_symlink
+                   || visited_links.emplace(subdir.device, subdir.inode).second)
+                {
+                    subdir.directory = table.add_directory(dir.directory,
+                        subdir.path.filename().string());
+                    pending.emplace_back(std::move(subdir));
+                }
+            }
 
-    hashes[block_index] = hash_algo.compute_hash(block_data);
+            found.clear();
+            subdirs.clear();
+            if (!pending.empty() || active == 0)
+            {
+                condition.notify_all();
+            }
+        }
+    };
 
-    return hashes[block_index];
-}
+    std::vector<std::thread> workers;
 
-void FileInfo::open_file() const
-{
-    if (!file_opened)
+    workers.reserve(threads_ - 1);
+    for (std::size_t i = 1; i < threads_; ++i)
     {
-        file_stream.open(path_.string(), std::ios::binary);
-        if (!file_stream)
-        {
-            throw std::runtime_error("Failed to open file: " + path_.string());
-        }
+        workers.emplace_back(worker);
+    }
 
-        file_opened = true;
+    worker();
+    for (auto& thread : workers)
+    {
+        thread.join();
     }
 }
 
-void FileInfo::close_file() const
+void FileScanner::scan_single_directory(
+    const Subdirectory&            dir,
+    std::vector<ScannedFile>&      files,
+    std::vector<Subdirectory>&     subdirs,
+    std::string&                   error) const
 {
-    if (file_opened)
+    constexpr std::int64_t NANOSECONDS_PER_SECOND = 1'000'000'000;
+    constexpr unsigned STATX_MASK = STATX_TYPE | STATX_SIZE | STATX_INO | STATX_MTIME;
+    DIR *const stream = ::opendir(dir.path.c_str());
+
+    if (stream == nullptr)
     {
-        file_stream.close();
-        file_opened = false;
+        error = std::error_code(errno, std::generic_category()).message();
+
+        return;
     }
-}
 
-FileScanner::FileScanner(
-    const bool         scan_level,
-    const BlockSize    block_size,
-    const MinFileSize  min_file_size,
-    const ExcludeDirs& exclude_dirs,
-    const FileMasks&   file_masks,
-    const ScanDirs&    scan_dirs)
-    :
-    scan_level_(scan_level),
-    exclude_dirs_(exclude_dirs.value),
-    file_masks_(file_masks.value),
-    scan_dirs_(scan_dirs.value),
-    block_size_(block_size.value),
-    min_file_size_(min_file_size.value)
-{
-    for (const auto& mask : file_masks_)
+    const int dir_fd = ::dirfd(stream);
+
+    for (const dirent *entry = ::readdir(stream); entry != nullptr;
+        entry = ::readdir(stream))
     {
-        const std::string regex_str = mask;
+        const char *const entry_name = static_cast<const char*>(entry->d_name);
+        const std::string_view name(entry_name);
 
-        std::string result;
-        for (const char character : regex_str)
+        if (name == "." || name == "..")
         {
-            if (character == '.')
-            {
-                result += "\\.";
-            }
-            else if (character == '*')
-            {
-                result += ".*";
-            }
-            else if (character == '?')
+            continue;
+        }
+
+        const bool is_directory = entry->d_type == DT_DIR;
+        const bool is_regular = entry->d_type == DT_REG;
+
+        if (is_directory)
+        {
+            const std::size_t node = exclude_dirs_.descend(dir.exclude_node, name);
+
+            if (scan_level_ && !exclude_dirs_.is_excluded(node))
             {
-                result += ".";
+                subdirs.emplace_back(Subdirectory{dir.path / entry_name, 0, 0, false,
+                    node, FileTable::NO_INDEX});
             }
-            else
+
+            continue;
+        }
+
+        if (  !file_masks_.matches(name)
+           && (is_regular || !scan_level_))
+        {
+            continue;
+        }
+
+        if (!is_regular && entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN)
+        {
+            continue;
+        }
+
+        struct statx info {};
+
+        if (::statx(dir_fd, entry_name, AT_STATX_SYNC_AS_STAT, STATX_MASK, &info) != 0)
+        {
+            continue;
+        }
+
+        const std::uint64_t device = makedev(info.stx_dev_major, info.stx_dev_minor);
+
+        if (S_ISDIR(info.stx_mode))
+        {
+            const std::size_t node = exclude_dirs_.descend(dir.exclude_node, name);
+
+            if (scan_level_ && !exclude_dirs_.is_excluded(node))
             {
-                result += character;
+                subdirs.emplace_back(Subdirectory{dir.path / entry_name, device,
+                    info.stx_ino, true, node, FileTable::NO_INDEX});
             }
         }
+        else if (  S_ISREG(info.stx_mode)
+                && info.stx_size >= min_file_size_
+                && file_masks_.matches(name))
+        {
+            FileKey key;
+            bool symlink = entry->d_type == DT_LNK;
+
+            if (entry->d_type == DT_UNKNOWN)
+            {
+                struct statx link_info {};
 
-        const std::string final_regex = "^" + result + "$";
+                symlink = ::statx(dir_fd, entry_name,
+                        AT_SYMLINK_NOFOLLOW | AT_STATX_SYNC_AS_STAT, STATX_TYPE,
+                        &link_info) == 0
+                    && S_ISLNK(link_info.stx_mode);
+            }
 
-        mask_regexes_.emplace_back(final_regex, std::regex::icase);
+            key.device = device;
+            key.inode = info.stx_ino;
+            key.size = info.stx_size;
+            key.mtime_ns = info.stx_mtime.tv_sec * NANOSECONDS_PER_SECOND
+                + info.stx_mtime.tv_nsec;
+            files.push_back({std::string(name), key, symlink});
+        }
     }
-}
 
+    ::closedir(stream);
+}
+#else
 void FileScanner::scan_directory_recursive(
     const boost::filesystem::path& dir,
-    std::vector<FileInfo>&         files)
+    FileTable&                     table)
 {
     boost::filesystem::recursive_directory_iterator iterator(
         dir, boost::filesystem::directory_options::follow_directory_symlink);
@@ -339,17 +517,22 @@ void FileScanner::scan_directory_recursive(
     {
         const boost::filesystem::path& path = iterator->path();
 
-        if (is_excluded(path.parent_path()))
+        if (exclude_dirs_.is_excluded(exclude_dirs_.find(path.parent_path())))
         {
             iterator.disable_recursion_pending();
+            ++iterator;
             continue;
         }
 
-        if (  boost::filesystem::is_regular_file(path)
-           && boost::filesystem::file_size(path) >= min_file_size_
-           && matches_masks(path))
+        if (  boost::filesystem::is_regular_file(iterator->status())
+           && file_masks_.matches(path.filename().string()))
         {
-            files.emplace_back(path, boost::filesystem::file_size(path), block_size_);
+            const uintmax_t size = boost::filesystem::file_size(path);
+
+            if (size >= min_file_size_)
+            {
+                add_scanned_file(path, size, table);
+            }
         }
 
         ++iterator;
@@ -358,23 +541,57 @@ void FileScanner::scan_directory_recursive(
 
 void FileScanner::scan_directory_non_recursive(
     const boost::filesystem::path& dir,
-    std::vector<FileInfo>&         files)
+    FileTable&                     table)
 {
     for (const auto& entry : boost::filesystem::directory_iterator(dir))
     {
         const boost::filesystem::path& path = entry.path();
-        if (  boost::filesystem::is_regular_file(path)
-           && boost::filesystem::file_size(path) >= min_file_size_
-           && matches_masks(path))
+
+        if (  boost::filesystem::is_regular_file(entry.status())
+           && file_masks_.matches(path.filename().string()))
         {
-            files.emplace_back(path, boost::filesystem::file_size(path), block_size_);
+            const uintmax_t size = boost::filesystem::file_size(path);
+
+            if (size >= min_file_size_)
+            {
+                add_scanned_file(path, size, table);
+            }
         }
     }
 }
 
-std::vector<FileInfo> FileScanner::scan_directories()
+void FileScanner::add_scanned_file(
+    const boost::filesystem::path& path,
+    const uintmax_t                size,
+    FileTable&                     table)
+{
+    const std::string parent = path.parent_path().string();
+    auto iterator = directories_.find(parent);
+
+    if (iterator == directories_.end())
+    {
+        iterator = directories_.emplace(parent,
+            table.add_directory(FileTable::NO_INDEX, parent)).first;
+    }
+
+    const FileTable::Index file =
+        table.add_file(iterator->second, path.filename().string(), size);
+
+    if (const auto key = query_file_key(path); key)
+    {
+        table.set_key(file, *key);
+    }
+
+    if (boost::filesystem::is_symlink(boost::filesystem::symlink_status(path)))
+    {
+        table.mark_symlink(file);
+    }
+}
+#endif
+
+std::vector<FileTable::Index> FileScanner::scan_directories(FileTable& table)
 {
-    std::vector<FileInfo> files;
+    std::vector<boost::filesystem::path> dirs;
 
     for (const auto& dir_str : scan_dirs_)
     {
@@ -387,20 +604,28 @@ std::vector<FileInfo> FileScanner::scan_directories()
             continue;
         }
 
-        if (is_excluded(dir))
+        if (exclude_dirs_.is_excluded(exclude_dirs_.find(dir)))
         {
             continue;
         }
 
+        dirs.emplace_back(dir);
+    }
+
+#if defined(__linux__)
+    scan_directories_parallel(dirs, table);
+#else
+    for (const auto& dir : dirs)
+    {
         try
         {
             if (scan_level_)
             {
-                scan_directory_recursive(dir, files);
+                scan_directory_recursive(dir, table);
             }
             else
             {
-                scan_directory_non_recursive(dir, files);
+                scan_directory_non_recursive(dir, table);
             }
         }
         catch (const boost::filesystem::filesystem_error& e)
@@ -408,133 +633,548 @@ std::vector<FileInfo> FileScanner::scan_directories()
             std::cerr << "Error scanning directory " << dir << ": " << e.what() << '\n';
         }
     }
+#endif
+
+    std::vector<FileTable::Index> files = table.sorted_files();
+
+    collapse_hard_links(table, files);
 
     return files;
 }
 
-bool FileScanner::matches_masks(const boost::filesystem::path& file_path) const
+void FileScanner::collapse_hard_links(
+    FileTable&                     table,
+    std::vector<FileTable::Index>& files)
 {
-    if (file_masks_.empty())
+    const auto inode_of = [&table](const FileTable::Index file)
     {
-        return true;
-    }
+        const auto key = table.key(file);
 
-    std::string filename = file_path.filename().string();
+        return std::pair{key->device, key->inode};
+    };
+    std::vector<FileTable::Index> keyed;
 
-    return std::ranges::any_of(mask_regexes_, [&filename](const std::regex& regex)
+    // A symlink shares the device and inode of its target but is no hard
+    // link, so it stays a file of its own.
+    for (const auto file : files)
     {
-        return std::regex_match(filename, regex);
-    });
-}
+        if (table.key(file) && !table.is_symlink(file))
+        {
+            keyed.emplace_back(file);
+        }
+    }
 
-bool FileScanner::is_excluded(const boost::filesystem::path& dir) const
-{
-    return std::ranges::any_of(exclude_dirs_, [&dir](const std::string& exclude_dir_str)
+    std::ranges::stable_sort(keyed, {}, inode_of);
+    for (std::size_t first = 0, current = 1; current < keyed.size(); ++current)
     {
-        const boost::filesystem::path exclude_dir(exclude_dir_str);
+        if (inode_of(keyed[current]) == inode_of(keyed[first]))
+        {
+            table.add_link(keyed[first], keyed[current]);
+        }
+        else
+        {
+            first = current;
+        }
+    }
 
-        return   dir == exclude_dir
-              || (  boost::filesystem::exists(exclude_dir)
-                 && dir.string().starts_with(canonical(exclude_dir).string()));
+    std::erase_if(files, [&table](const FileTable::Index file)
+    {
+        return table.is_link(file);
     });
 }
 
-
 DuplicateFinder::DuplicateFinder(
-    HashAlgorithm   hash_algo,
-    const uintmax_t block_size)
+    FileTable&        table,
+    HashAlgorithm     hash_algo,
+    const uintmax_t   block_size,
+    const io_backend  backend,
+    const ThreadCount threads)
     :
-    hash_algo_(std::move(hash_algo)),
-    block_size_(block_size) {}
+    table_(table),
+    block_size_(block_size),
+    pipeline_(table, std::move(hash_algo), block_size, backend, threads) {}
 
-std::vector<std::vector<FileInfo>>
-    DuplicateFinder::find_duplicates(std::vector<FileInfo>& files)
+void DuplicateFinder::use_cache(const HashCache& cache)
 {
-    std::unordered_map<uintmax_t, std::vector<FileInfo*>> files_by_size;
+    cache_ = &cache;
+}
 
-    for (auto& file : files)
-    {
-        files_by_size[file.get_size()].emplace_back(&file);
-    }
+std::uint64_t DuplicateFinder::bytes_read() const
+{
+    return pipeline_.bytes_read();
+}
+
+const BlockPipeline& DuplicateFinder::pipeline() const
+{
+    return pipeline_;
+}
 
-    std::vector<std::vector<FileInfo>> duplicate_groups;
+// Several size classes are compared at once so that every round of block
+// reads spans many files, while groups are still reported in size order.
+void DuplicateFinder::find_duplicates(
+    std::span<const FileTable::Index> files,
+    const GroupHandler&               on_group)
+{
+    const auto size_of = [this](const FileTable::Index file)
+    {
+        return table_.file_size(file);
+    };
+    std::vector<FileTable::Index> files_by_size(files.begin(), files.end());
+    std::deque<SizeClass> size_classes;
 
-    for (auto& [size, size_group] : files_by_size)
+    std::ranges::stable_sort(files_by_size, {}, size_of);
+    for (auto begin = files_by_size.cbegin();
+        begin != files_by_size.cend() || !size_classes.empty();)
     {
-        if (size_group.size() < 2)
+        while (  begin != files_by_size.cend()
+              && size_classes.size() < pipeline_.queue_depth())
         {
-            continue;
+            const uintmax_t size = size_of(*begin);
+            const auto end = std::find_if(begin, files_by_size.cend(),
+                [&size_of, size](const FileTable::Index file)
+                {
+                    return size_of(file) != size;
+                });
+
+            size_classes.emplace_back().files.assign(begin, end);
+            start_size_class(size_classes.back());
+            begin = end;
         }
 
-        auto groups = find_duplicates_in_group(size_group);
-        duplicate_groups.insert(duplicate_groups.end(), groups.begin(), groups.end());
+        compare_next_blocks(size_classes);
+        while (!size_classes.empty() && size_classes.front().finished())
+        {
+            report_size_class(size_classes.front(), on_group);
+            size_classes.pop_front();
+        }
     }
-
-    return duplicate_groups;
 }
 
-std::vector<std::vector<FileInfo>>
-    DuplicateFinder::find_duplicates_in_group(std::vector<FileInfo*>& files)
+void DuplicateFinder::start_size_class(SizeClass& size_class)
 {
-    const std::size_t num_blocks = (files[0]->get_size() + block_size_ - 1) / block_size_;
-
-    for (std::size_t block_idx = 0; block_idx < num_blocks; ++block_idx)
+    for (const auto file : size_class.files)
     {
-        std::unordered_map<std::string, std::vector<FileInfo*>> files_by_hash;
-
-        for (auto *file : files)
+        if (table_.next_link(file) != FileTable::NO_INDEX)
         {
-            const std::string hash = file->compute_block_hash(block_idx, hash_algo_);
-
-            files_by_hash[hash].emplace_back(file);
+            size_class.hard_linked.emplace_back(file);
         }
+    }
 
-        files.clear();
-        for (auto& [hash, hash_group] : files_by_hash)
+    if (size_class.files.size() < 2)
+    {
+        return;
+    }
+
+    size_class.num_blocks =
+        (table_.file_size(size_class.files[0]) + block_size_ - 1) / block_size_;
+    size_class.block_order = block_visit_order(size_class.num_blocks);
+    for (const auto file : size_class.files)
+    {
+        if (cache_ != nullptr)
         {
-            if (hash_group.size() > 1)
-            {
-                files.insert(files.end(), hash_group.begin(), hash_group.end());
-            }
+            load_cached_hashes(file, size_class.num_blocks);
         }
 
-        if (files.empty())
+        if (size_class.num_blocks != 0)
         {
-            break;
+            static_cast<void>(table_.digests(file, size_class.num_blocks));
         }
     }
+}
 
-    std::unordered_map<std::string, std::vector<FileInfo*>> files_by_all_hashes;
-    for (auto *file : files)
-    {
-        std::string all_hashes;
+void DuplicateFinder::compare_next_blocks(std::deque<SizeClass>& size_classes)
+{
+    std::vector<BlockPipeline::Request> requests;
 
-        for (const auto& hash : file->get_hashes())
+    for (const auto& size_class : size_classes)
+    {
+        if (size_class.finished())
         {
-            all_hashes += hash;
+            continue;
         }
 
-        files_by_all_hashes[all_hashes].emplace_back(file);
-    }
+        const std::size_t block_idx = size_class.block_order[size_class.next_block];
 
-    std::vector<std::vector<FileInfo>> duplicate_groups;
-    for (auto& [all_hashes, hash_group] : files_by_all_hashes)
-    {
-        if (hash_group.size() > 1)
+        for (const auto file : size_class.files)
         {
-            std::vector<FileInfo> group;
+            std::string& hash = table_.digests(file, size_class.num_blocks)[block_idx];
 
-            for (auto *file : hash_group)
+            if (hash.empty())
             {
-                group.emplace_back(*file);
+                requests.push_back({file, block_idx * block_size_, &hash});
             }
-
-            duplicate_groups.emplace_back(group);
         }
     }
 
-    return duplicate_groups;
-}
+    pipeline_.run(requests);
+    for (auto& size_class : size_classes)
+    {
+        if (size_class.finished())
+        {
+            continue;
+        }
+
+        const std::size_t block_idx = size_class.block_order[size_class.next_block++];
+        std::unordered_map<std::string, std::vector<FileTable::Index>> files_by_hash;
+
+        for (const auto file : size_class.files)
+        {
+            files_by_hash[table_.digests(file, size_class.num_blocks)[block_idx]]
+                .emplace_back(file);
+        }
+
+        size_class.files.clear();
+        for (auto& [hash, hash_group] : files_by_hash)
+        {
+            if (hash_group.size() > 1)
+            {
+                size_class.files.insert(size_class.files.end(), hash_group.begin(),
+                    hash_group.end());
+            }
+            else
+            {
+                pipeline_.release(hash_group.front());
+            }
+        }
+    }
+}
+
+void DuplicateFinder::report_size_class(
+    SizeClass&          size_class,
+    const GroupHandler& on_group)
+{
+    std::unordered_map<std::string, std::vector<FileTable::Index>> files_by_all_hashes;
+    std::set<FileTable::Index> grouped;
+
+    if (size_class.files.size() > 1)
+    {
+        for (const auto file : size_class.files)
+        {
+            std::string all_hashes;
+
+            for (const auto& hash : table_.find_digests(file))
+            {
+                all_hashes += hash;
+            }
+
+            files_by_all_hashes[all_hashes].emplace_back(file);
+            pipeline_.release(file);
+        }
+    }
+
+    for (const auto& [all_hashes, hash_group] : files_by_all_hashes)
+    {
+        if (hash_group.size() > 1)
+        {
+            grouped.insert(hash_group.begin(), hash_group.end());
+            on_group(hash_group);
+        }
+    }
+
+    for (const auto file : size_class.hard_linked)
+    {
+        if (!grouped.contains(file))
+        {
+            const std::array group {file};
+
+            on_group(group);
+        }
+    }
+}
+
+void DuplicateFinder::load_cached_hashes(
+    const FileTable::Index file,
+    const std::size_t      num_blocks)
+{
+    const auto key = table_.key(file);
+
+    if (!key || !table_.find_digests(file).empty())
+    {
+        return;
+    }
+
+    if (const auto *cached_hashes = cache_->find(*key);
+        cached_hashes && cached_hashes->size() == num_blocks)
+    {
+        std::ranges::copy(*cached_hashes, table_.digests(file, num_blocks).begin());
+    }
+}
+
+DuplicateIndex::DuplicateIndex(
+    HashAlgorithm     hash_algo,
+    const std::size_t block_size)
+    :
+    finder_(std::make_unique<DuplicateFinder>(table_, std::move(hash_algo), block_size,
+        io_backend::automatic, ThreadCount{1})) {}
+
+DuplicateIndex::~DuplicateIndex() = default;
+
+void DuplicateIndex::load(
+    FileTable                         table,
+    std::span<const FileTable::Index> files)
+{
+    table_ = std::move(table);
+    size_classes_.clear();
+    files_.clear();
+    directories_.clear();
+    removed_ = 0;
+
+    for (const auto file : files)
+    {
+        const auto digests = table_.find_digests(file);
+        const std::vector<std::string> hashes(digests.begin(), digests.end());
+        std::vector<FileTable::Index> links;
+
+        for (auto link = table_.next_link(file); link != FileTable::NO_INDEX;
+            link = table_.next_link(link))
+        {
+            links.emplace_back(link);
+        }
+
+        table_.unlink(file);
+        for (const auto link : links)
+        {
+            if (!hashes.empty())
+            {
+                std::ranges::copy(hashes, table_.digests(link, hashes.size()).begin());
+            }
+
+            register_file(link);
+        }
+
+        register_file(file);
+    }
+}
+
+std::vector<DuplicateIndex::Change> DuplicateIndex::refresh_all()
+{
+    std::vector<Change> changes;
+    std::vector<uintmax_t> sizes;
+
+    sizes.reserve(size_classes_.size());
+    for (const auto& [size, size_class] : size_classes_)
+    {
+        sizes.emplace_back(size);
+    }
+
+    for (const auto size : sizes)
+    {
+        refresh(size, changes);
+    }
+
+    return changes;
+}
+
+std::vector<DuplicateIndex::Change> DuplicateIndex::add(
+    const boost::filesystem::path& path,
+    const uintmax_t                size)
+{
+    constexpr std::size_t COMPACTION_THRESHOLD = 1024;
+    std::vector<Change> changes;
+    const auto old_size = erase(path.string());
+
+    if (removed_ > files_.size() + COMPACTION_THRESHOLD)
+    {
+        compact();
+    }
+
+    register_file(add_path(path, size));
+    if (old_size && *old_size != size)
+    {
+        refresh(*old_size, changes);
+    }
+
+    refresh(size, changes);
+
+    return changes;
+}
+
+std::vector<DuplicateIndex::Change> DuplicateIndex::remove(
+    const boost::filesystem::path& path)
+{
+    std::vector<Change> changes;
+
+    if (const auto old_size = erase(path.string()); old_size)
+    {
+        refresh(*old_size, changes);
+    }
+
+    return changes;
+}
+
+std::vector<DuplicateIndex::Change> DuplicateIndex::remove_directory(
+    const boost::filesystem::path& dir)
+{
+    std::vector<Change> changes;
+    const std::string dir_string = dir.string();
+    std::vector<std::string> paths;
+    std::set<uintmax_t> touched_sizes;
+
+    for (const auto& [path, file] : files_)
+    {
+        if (is_inside_directory(path, dir_string))
+        {
+            paths.emplace_back(path);
+        }
+    }
+
+    for (const auto& path : paths)
+    {
+        if (const auto old_size = erase(path); old_size)
+        {
+            touched_sizes.insert(*old_size);
+        }
+    }
+
+    for (const auto size : touched_sizes)
+    {
+        refresh(size, changes);
+    }
+
+    return changes;
+}
+
+std::size_t DuplicateIndex::size() const noexcept
+{
+    return files_.size();
+}
+
+FileTable::Index DuplicateIndex::add_path(
+    const boost::filesystem::path& path,
+    const uintmax_t                size)
+{
+    const std::string parent = path.parent_path().string();
+    auto iterator = directories_.find(parent);
+
+    if (iterator == directories_.end())
+    {
+        iterator = directories_.emplace(parent,
+            table_.add_directory(FileTable::NO_INDEX, parent)).first;
+    }
+
+    return table_.add_file(iterator->second, path.filename().string(), size);
+}
+
+void DuplicateIndex::register_file(const FileTable::Index file)
+{
+    files_.insert_or_assign(table_.path(file).string(), file);
+    size_classes_[table_.file_size(file)].files.emplace_back(file);
+}
+
+std::optional<uintmax_t> DuplicateIndex::erase(const std::string& path)
+{
+    const auto iterator = files_.find(path);
+
+    if (iterator == files_.cend())
+    {
+        return std::nullopt;
+    }
+
+    const FileTable::Index file = iterator->second;
+    const uintmax_t size = table_.file_size(file);
+
+    files_.erase(iterator);
+    std::erase(size_classes_[size].files, file);
+    table_.remove(file);
+    ++removed_;
+
+    return size;
+}
+
+void DuplicateIndex::compact()
+{
+    const FileTable table = std::exchange(table_, FileTable());
+    std::vector<FileTable::Index> moved(table.size(), FileTable::NO_INDEX);
+
+    directories_.clear();
+    for (auto& [path, file] : files_)
+    {
+        const auto digests = table.find_digests(file);
+        const FileTable::Index moved_file = add_path(path, table.file_size(file));
+
+        if (!digests.empty())
+        {
+            std::ranges::copy(digests,
+                table_.digests(moved_file, digests.size()).begin());
+        }
+
+        moved[file] = moved_file;
+        file = moved_file;
+    }
+
+    for (auto& [size, size_class] : size_classes_)
+    {
+        for (auto& file : size_class.files)
+        {
+            file = moved[file];
+        }
+    }
+
+    removed_ = 0;
+}
+
+void DuplicateIndex::refresh(
+    const uintmax_t      size,
+    std::vector<Change>& changes)
+{
+    const auto iterator = size_classes_.find(size);
+
+    if (iterator == size_classes_.cend())
+    {
+        return;
+    }
+
+    auto& size_class = iterator->second;
+    std::set<std::vector<std::string>> groups;
+
+    if (size_class.files.size() > 1)
+    {
+        finder_->find_duplicates(size_class.files,
+            [this, &groups](std::span<const FileTable::Index> group)
+            {
+                std::vector<std::string> paths;
+
+                if (group.size() < 2)
+                {
+                    return;
+                }
+
+                paths.reserve(group.size());
+                for (const auto file : group)
+                {
+                    paths.emplace_back(table_.path(file).string());
+                }
+
+                std::ranges::sort(paths);
+                groups.insert(std::move(paths));
+            });
+    }
+
+    for (const auto& group : size_class.groups)
+    {
+        if (!groups.contains(group))
+        {
+            changes.push_back({false, group});
+        }
+    }
+
+    for (const auto& group : groups)
+    {
+        if (!size_class.groups.contains(group))
+        {
+            changes.push_back({true, group});
+        }
+    }
+
+    if (size_class.files.empty())
+    {
+        size_classes_.erase(iterator);
+    }
+    else
+    {
+        size_class.groups = std::move(groups);
+    }
+}
 
 std::pair<ProcessStatus, Options> option_process(std::span<const char *const> argv)
 {
@@ -604,7 +1244,135 @@ std::pair<ProcessStatus, Options> option_process(std::span<const char *const> ar
                         throw;
                     }
                 }),
-                "hashing algorithm to use (allowed values: crc32, md5)");
+                "hashing algorithm to use (allowed values: crc32, md5)")
+            ("threads", boost::program_options::value<std::int64_t>()
+                ->default_value(0)->notifier([&options, negative_check](std::int64_t val)
+                {
+                    negative_check(val);
+                    options.threads = static_cast<decltype(options.threads)>(val);
+                }),
+                "number of worker threads, 0 - use all available cores")
+            ("cache", boost::program_options::value<decltype(options.cache_path)>
+                (&options.cache_path),
+                "file to keep block hashes between runs, unchanged files are not read "
+                "again")
+            ("report_hardlinks",
+                boost::program_options::bool_switch(&options.report_hardlinks),
+                "list hard links to the same file separately instead of mixing them "
+                "into duplicate groups")
+            ("stats", boost::program_options::bool_switch(&options.stats),
+                "print the number of scanned files and bytes read to stderr")
+            ("watch", boost::program_options::bool_switch(&options.watch),
+                "keep watching the scanned directories after the first report and "
+                "print duplicate groups as they are formed or broken")
+            ("output_format", boost::program_options::value<std::string>()
+                ->default_value("text")->notifier([&options](const std::string& value)
+                {
+                    if (value == "text")
+                    {
+                        options.format = output_format::text;
+                    }
+                    else if (value == "ndjson")
+                    {
+                        options.format = output_format::ndjson;
+                    }
+                    else
+                    {
+                        using boost::program_options::validation_error;
+
+                        throw validation_error(validation_error::invalid_option_value,
+                            "output_format", value);
+                    }
+                }),
+                "output format (allowed values: text, ndjson - one JSON object per "
+                "group with its size and digest)")
+            ("print0", boost::program_options::bool_switch(&options.print0),
+                "terminate every path and group with NUL instead of a newline in text "
+                "output")
+            ("verify", boost::program_options::bool_switch(&options.verify),
+                "byte-compare the files of every duplicate group before reporting it, "
+                "groups whose files differ are split")
+            ("action", boost::program_options::value<std::string>()
+                ->notifier([&options](const std::string& value)
+                {
+                    if (value == "hardlink")
+                    {
+                        options.action = dedup_action::hardlink;
+                    }
+                    else if (value == "reflink")
+                    {
+                        options.action = dedup_action::reflink;
+                    }
+                    else if (value == "delete")
+                    {
+                        options.action = dedup_action::remove;
+                    }
+                    else
+                    {
+                        using boost::program_options::validation_error;
+
+                        throw validation_error(validation_error::invalid_option_value,
+                            "action", value);
+                    }
+                }),
+                "replace every verified duplicate with a hard link or a reflink to the "
+                "kept file, or delete it (allowed values: hardlink, reflink, delete)")
+            ("keep", boost::program_options::value<std::string>()
+                ->default_value("first_scan_dir")->notifier(
+                    [&options](const std::string& value)
+                {
+                    if (value == "first_scan_dir")
+                    {
+                        options.keep = keep_policy::first_scan_dir;
+                    }
+                    else if (value == "oldest")
+                    {
+                        options.keep = keep_policy::oldest;
+                    }
+                    else if (value == "shortest_path")
+                    {
+                        options.keep = keep_policy::shortest_path;
+                    }
+                    else
+                    {
+                        using boost::program_options::validation_error;
+
+                        throw validation_error(validation_error::invalid_option_value,
+                            "keep", value);
+                    }
+                }),
+                "file of a group kept by --action (allowed values: first_scan_dir - "
+                "from the earliest listed scan directory, oldest, shortest_path)")
+            ("dry_run", boost::program_options::bool_switch(&options.dry_run),
+                "only report what --action would do")
+            ("io_backend", boost::program_options::value<std::string>()
+                ->default_value("auto")->notifier([&options](const std::string& value)
+                {
+                    if (value == "auto")
+                    {
+                        options.io = io_backend::automatic;
+                    }
+                    else if (value == "io_uring")
+                    {
+                        options.io = io_backend::io_uring;
+                    }
+                    else if (value == "threads")
+                    {
+                        options.io = io_backend::threads;
+                    }
+                    else
+                    {
+                        using boost::program_options::validation_error;
+
+                        throw validation_error(validation_error::invalid_option_value,
+                            "io_backend", value);
+                    }
+                }),
+                "how block reads are issued (allowed values: auto - io_uring when the "
+                "kernel allows it, io_uring, threads - a pool of pread() threads)")
+            ("similar", boost::program_options::value<uintmax_t>(&options.similar_bytes),
+                "instead of duplicate groups, report pairs of files that share at "
+                "least this many bytes of content-defined chunks");
 
         cmdline_options.add(mandatory_options).add(optional_options);
 
@@ -619,6 +1387,27 @@ std::pair<ProcessStatus, Options> option_process(std::span<const char *const> ar
         }
 
         boost::program_options::notify(variables_map);
+        if (options.print0 && options.format != output_format::text)
+        {
+            throw boost::program_options::error("--print0 requires text output format");
+        }
+
+        if (options.dry_run && options.action == dedup_action::none)
+        {
+            throw boost::program_options::error("--dry_run requires --action");
+        }
+
+        if (options.watch && options.action != dedup_action::none)
+        {
+            throw boost::program_options::error("--action cannot be used with --watch");
+        }
+
+        if (  options.similar_bytes != 0
+           && (options.watch || options.verify || options.action != dedup_action::none))
+        {
+            throw boost::program_options::error(
+                "--similar cannot be used with --watch, --verify or --action");
+        }
     }
     catch (const boost::program_options::error& e)
     {
@@ -630,45 +1419,410 @@ std::pair<ProcessStatus, Options> option_process(std::span<const char *const> ar
     return {ret, options};
 }
 
+std::string json_escape(std::string_view value)
+{
+    constexpr unsigned char FIRST_PRINTABLE = 0x20;
+    constexpr unsigned HEX_DIGIT_BITS = 4;
+    constexpr unsigned HEX_DIGIT_MASK = 0xF;
+    constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+    std::string result;
+
+    result.reserve(value.size());
+    for (const char character : value)
+    {
+        const auto code = static_cast<unsigned char>(character);
+
+        if (character == '"' || character == '\\')
+        {
+            result += '\\';
+            result += character;
+        }
+        else if (code < FIRST_PRINTABLE)
+        {
+            result += "\\u00";
+            result += HEX_DIGITS[code >> HEX_DIGIT_BITS];
+            result += HEX_DIGITS[code & HEX_DIGIT_MASK];
+        }
+        else
+        {
+            result += character;
+        }
+    }
+
+    return result;
+}
+
+namespace
+{
+    class GroupPrinter
+    {
+        void print_paths(
+            FileTable::Index file,
+            bool             with_links) const;
+        void print_json(
+            std::string_view                  type,
+            std::span<const FileTable::Index> group,
+            bool                              with_links) const;
+
+        const Options& options_;
+        const FileTable& table_;
+        char separator_;
+        std::size_t groups_{0};
+    public:
+        GroupPrinter(
+            const Options&   options,
+            const FileTable& table);
+
+        void print_group(std::span<const FileTable::Index> group);
+        void print_hard_links(std::span<const FileTable::Index> files);
+        void print_similar(const SimilarPair& pair);
+        void finish() const;
+    };
+
+    GroupPrinter::GroupPrinter(
+        const Options&   options,
+        const FileTable& table)
+        :
+        options_(options),
+        table_(table),
+        separator_(options.print0 ? '\0' : '\n') {}
+
+    void GroupPrinter::print_group(std::span<const FileTable::Index> group)
+    {
+        if (options_.report_hardlinks && group.size() < 2)
+        {
+            return;
+        }
+
+        ++groups_;
+        if (options_.format == output_format::ndjson)
+        {
+            print_json("duplicates", group, !options_.report_hardlinks);
+
+            return;
+        }
+
+        for (const auto file : group)
+        {
+            print_paths(file, !options_.report_hardlinks);
+        }
+
+        std::cout << separator_;
+    }
+
+    void GroupPrinter::print_hard_links(std::span<const FileTable::Index> files)
+    {
+        if (files.empty())
+        {
+            return;
+        }
+
+        if (options_.format == output_format::ndjson)
+        {
+            for (const auto file : files)
+            {
+                const std::array group {file};
+
+                print_json("hardlinks", group, true);
+            }
+
+            groups_ += files.size();
+
+            return;
+        }
+
+        groups_ += files.size();
+        std::cout << "Hard links:" << separator_;
+        for (const auto file : files)
+        {
+            print_paths(file, true);
+            std::cout << separator_;
+        }
+    }
+
+    void GroupPrinter::print_similar(const SimilarPair& pair)
+    {
+        ++groups_;
+        if (options_.format == output_format::ndjson)
+        {
+            std::cout << R"({"type":"similar","shared_bytes":)" << pair.shared_bytes
+                << R"(,"paths":[")" << json_escape(table_.path(pair.first).string())
+                << R"(",")" << json_escape(table_.path(pair.second).string())
+                << "\"]}\n";
+
+            return;
+        }
+
+        std::cout << "Shared bytes: " << pair.shared_bytes << separator_
+            << table_.path(pair.first).string() << separator_
+            << table_.path(pair.second).string() << separator_ << separator_;
+    }
+
+    void GroupPrinter::finish() const
+    {
+        if (groups_ == 0 && options_.format == output_format::text)
+        {
+            std::cout << (options_.similar_bytes != 0 ? "No similar files found."
+                : "No duplicate files found.") << separator_;
+        }
+    }
+
+    void GroupPrinter::print_paths(
+        const FileTable::Index file,
+        const bool             with_links) const
+    {
+        std::cout << table_.path(file).string() << separator_;
+        if (with_links)
+        {
+            for (auto link = table_.next_link(file); link != FileTable::NO_INDEX;
+                link = table_.next_link(link))
+            {
+                std::cout << table_.path(link).string() << separator_;
+            }
+        }
+    }
+
+    void GroupPrinter::print_json(
+        std::string_view                  type,
+        std::span<const FileTable::Index> group,
+        const bool                        with_links) const
+    {
+        const auto is_hashed = [](const std::string& hash) noexcept
+        {
+            return !hash.empty();
+        };
+        const auto hashes = table_.find_digests(group.front());
+        const char *separator = "";
+
+        std::cout << R"({"type":")" << type << R"(","size":)"
+            << table_.file_size(group.front());
+        if (!hashes.empty() && std::ranges::all_of(hashes, is_hashed))
+        {
+            std::string all_hashes;
+
+            for (const auto& hash : hashes)
+            {
+                all_hashes += hash;
+            }
+
+            std::cout << R"(,"digest":")"
+                << options_.hash_algorithm.compute_hash(all_hashes) << '"';
+        }
+
+        std::cout << R"(,"paths":[)";
+        for (const auto file : group)
+        {
+            std::cout << separator << '"' << json_escape(table_.path(file).string())
+                << '"';
+            separator = ",";
+            if (with_links)
+            {
+                for (auto link = table_.next_link(file); link != FileTable::NO_INDEX;
+                    link = table_.next_link(link))
+                {
+                    std::cout << ",\"" << json_escape(table_.path(link).string()) << '"';
+                }
+            }
+        }
+
+        std::cout << "]}\n";
+    }
+
+    ProcessStatus watch_files(
+        const Options&                    options,
+        FileTable                         table,
+        std::span<const FileTable::Index> files)
+    {
+        DuplicateIndex index(options.hash_algorithm, options.block_size);
+
+        index.load(std::move(table), files);
+        static_cast<void>(index.refresh_all());
+
+        DirectoryWatcher watcher(options, index);
+
+        watcher.setup_signal_handling();
+
+        return watcher.run();
+    }
+
+    void find_similar_files(
+        const Options&                    options,
+        const FileTable&                  table,
+        std::span<const FileTable::Index> files)
+    {
+        ChunkIndex index(table, ThreadCount{resolve_thread_count(options.threads)});
+        GroupPrinter printer(options, table);
+        std::vector<FileTable::Index> candidates;
+
+        // A file smaller than the threshold cannot share that many bytes.
+        std::ranges::copy_if(files, std::back_inserter(candidates),
+            [&table, &options](const FileTable::Index file)
+            {
+                return table.file_size(file) >= options.similar_bytes;
+            });
+        index.add_files(candidates);
+        for (const auto& pair : index.similar_pairs(options.similar_bytes))
+        {
+            printer.print_similar(pair);
+        }
+
+        printer.finish();
+        if (options.stats)
+        {
+            std::cerr << "Files scanned: " << files.size() << '\n'
+                << "Bytes read: " << index.bytes_read() << '\n'
+                << "Chunks indexed: " << index.chunk_count() << '\n';
+        }
+    }
+} // namespace
+
 ProcessStatus process_files(const Options& options)
 {
     auto ret = ProcessStatus::SUCCESS;
 
     try
     {
-        FileScanner scanner(options.scan_level, {options.block_size},
-            {options.min_file_size}, {options.exclude_dirs}, {options.file_masks},
-            {options.scan_dirs});
+        FileScanner scanner(options.scan_level, {options.min_file_size},
+            {options.exclude_dirs}, {options.file_masks}, {options.scan_dirs},
+            {options.threads});
+        FileTable table;
 
-        auto files = scanner.scan_directories();
+        const auto files = scanner.scan_directories(table);
 
         if (files.empty())
         {
-            std::cout << "No files found matching the criteria.\n";
+            if (options.format == output_format::text)
+            {
+                std::cout << "No files found matching the criteria."
+                    << (options.print0 ? '\0' : '\n');
+            }
+
+            return options.watch ? watch_files(options, std::move(table), files) : ret;
+        }
+
+        if (options.similar_bytes != 0)
+        {
+            find_similar_files(options, table, files);
 
             return ret;
         }
 
-        DuplicateFinder finder(options.hash_algorithm, options.block_size);
+        std::optional<HashCache> cache;
+        DuplicateFinder finder(table, options.hash_algorithm, options.block_size,
+            options.io, ThreadCount{resolve_thread_count(options.threads)});
+
+        if (!options.cache_path.empty())
+        {
+            cache.emplace(options.cache_path, options.block_size,
+                options.hash_algorithm.get_value());
+            if (!cache->load())
+            {
+                std::cerr << "Warning: Ignoring unreadable hash cache: "
+                    << options.cache_path << '\n';
+            }
 
-        auto duplicate_groups = finder.find_duplicates(files);
+            finder.use_cache(*cache);
+        }
 
-        if (duplicate_groups.empty())
+        GroupPrinter printer(options, table);
+        Deduplicator deduplicator(options, table);
+        const auto print_group = [&printer, &deduplicator](
+            std::span<const FileTable::Index> group)
         {
-            std::cout << "No duplicate files found.\n";
+            printer.print_group(group);
+            deduplicator.process(group);
+        };
+        std::optional<GroupVerifier> verifier;
+
+        // Files are never replaced on the strength of a digest alone.
+        if (options.verify || options.action != dedup_action::none)
+        {
+            verifier.emplace(table, ThreadCount{resolve_thread_count(options.threads)},
+                print_group);
+            finder.find_duplicates(files,
+                [&verifier](std::span<const FileTable::Index> group)
+                {
+                    verifier->add(group);
+                });
+            verifier->finish();
         }
         else
         {
-            for (const auto& group : duplicate_groups)
+            finder.find_duplicates(files, print_group);
+        }
+
+        if (cache)
+        {
+            const auto has_hash = [](const std::string& hash) noexcept
+            {
+                return !hash.empty();
+            };
+
+            for (const auto file : files)
             {
-                for (const auto& file : group)
+                const auto key = table.key(file);
+                const auto hashes = table.find_digests(file);
+
+                if (key && std::ranges::any_of(hashes, has_hash))
                 {
-                    std::cout << file.get_path().string() << '\n';
+                    cache->store(*key, {hashes.begin(), hashes.end()});
                 }
+            }
 
-                std::cout << '\n';
+            if (!cache->save())
+            {
+                std::cerr << "Warning: Failed to save hash cache: " << options.cache_path
+                    << '\n';
             }
         }
+
+        if (options.stats)
+        {
+            std::uint64_t bytes_total = 0;
+
+            for (const auto file : files)
+            {
+                bytes_total += table.file_size(file);
+            }
+
+            std::cerr << "Files scanned: " << files.size() << '\n'
+                << "Bytes read: " << finder.bytes_read() << " of " << bytes_total << '\n'
+                << "Read backend: "
+                << (finder.pipeline().backend() == io_backend::io_uring ? "io_uring"
+                    : "threads")
+                << ", queue depth " << finder.pipeline().queue_depth() << '\n';
+            if (verifier)
+            {
+                std::cerr << "Bytes verified: " << verifier->bytes_read() << '\n';
+            }
+        }
+
+        if (options.report_hardlinks)
+        {
+            std::vector<FileTable::Index> hard_linked;
+
+            for (const auto file : files)
+            {
+                if (table.next_link(file) != FileTable::NO_INDEX)
+                {
+                    hard_linked.emplace_back(file);
+                }
+            }
+
+            printer.print_hard_links(hard_linked);
+        }
+
+        printer.finish();
+        deduplicator.finish();
+        if (deduplicator.failed())
+        {
+            ret = ProcessStatus::FILE_ERROR;
+        }
+
+        if (options.watch)
+        {
+            ret = watch_files(options, std::move(table), files);
+        }
     }
     catch (const std::exception& e)
     {
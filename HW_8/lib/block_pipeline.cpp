@@ -0,0 +1,558 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <block_pipeline.hpp>
+
+namespace
+{
+    // Enough requests in flight to keep an NVMe device busy, bounded by the
+    // memory the block buffers take.
+    constexpr std::size_t MAX_QUEUE_DEPTH = 128;
+    constexpr std::size_t MAX_BUFFERED_BYTES = 32 * 1024 * 1024;
+    // pread() threads spend their time blocked, so the fallback uses more of
+    // them than there are cores.
+    constexpr std::size_t MIN_IO_THREADS = 16;
+} // namespace
+
+// Runs a task over an index range on persistent threads; the calling thread
+// takes part too.
+class WorkerPool
+{
+    void work();
+    void run_tasks();
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    const std::function<void(std::size_t)>* task_{nullptr};
+    std::size_t count_{0};
+    std::atomic<std::size_t> next_{0};
+    std::size_t active_{0};
+    std::uint64_t generation_{0};
+    bool stopping_{false};
+    std::exception_ptr error_;
+public:
+    explicit WorkerPool(std::size_t threads);
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    WorkerPool& operator=(WorkerPool&&) = delete;
+    ~WorkerPool();
+
+    void run(
+        std::size_t                             count,
+        const std::function<void(std::size_t)>& task);
+};
+
+WorkerPool::WorkerPool(const std::size_t threads)
+{
+    for (std::size_t i = 1; i < threads; ++i)
+    {
+        threads_.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+
+        stopping_ = true;
+    }
+
+    wake_.notify_all();
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(
+    const std::size_t                       count,
+    const std::function<void(std::size_t)>& task)
+{
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+
+        task_ = &task;
+        count_ = count;
+        next_ = 0;
+        active_ = threads_.size();
+        error_ = nullptr;
+        ++generation_;
+    }
+
+    wake_.notify_all();
+    run_tasks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    idle_.wait(lock, [this]() noexcept
+    {
+        return active_ == 0;
+    });
+    if (error_)
+    {
+        std::rethrow_exception(error_);
+    }
+}
+
+void WorkerPool::work()
+{
+    std::uint64_t generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            wake_.wait(lock, [this, generation]() noexcept
+            {
+                return stopping_ || generation_ != generation;
+            });
+            if (stopping_)
+            {
+                return;
+            }
+
+            generation = generation_;
+        }
+
+        run_tasks();
+
+        const std::lock_guard<std::mutex> lock(mutex_);
+
+        if (--active_ == 0)
+        {
+            idle_.notify_one();
+        }
+    }
+}
+
+void WorkerPool::run_tasks()
+{
+    try
+    {
+        for (std::size_t index = next_++; index < count_; index = next_++)
+        {
+            (*task_)(index);
+        }
+    }
+    catch (...)
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!error_)
+        {
+            error_ = std::current_exception();
+        }
+
+        next_ = count_;
+    }
+}
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+// A minimal io_uring submission and completion queue driven by raw system
+// calls, so no liburing is needed at build or run time.
+class UringQueue
+{
+    struct Mapping
+    {
+        void* address{MAP_FAILED};
+        std::size_t size{0};
+    };
+
+    void map(
+        Mapping&    mapping,
+        std::size_t size,
+        off_t       offset) const;
+    void close();
+
+    int ring_fd_{-1};
+    Mapping sq_ring_;
+    Mapping cq_ring_;
+    Mapping sqes_;
+    std::uint32_t* sq_tail_{nullptr};
+    std::uint32_t* sq_mask_{nullptr};
+    std::uint32_t* sq_array_{nullptr};
+    std::uint32_t* cq_head_{nullptr};
+    std::uint32_t* cq_tail_{nullptr};
+    std::uint32_t* cq_mask_{nullptr};
+    io_uring_cqe* cqes_{nullptr};
+    io_uring_sqe* sqe_array_{nullptr};
+    std::vector<iovec> iovecs_;
+public:
+    explicit UringQueue(unsigned entries);
+    UringQueue(const UringQueue&) = delete;
+    UringQueue(UringQueue&&) = delete;
+    UringQueue& operator=(const UringQueue&) = delete;
+    UringQueue& operator=(UringQueue&&) = delete;
+    ~UringQueue();
+
+    // Submits one read per buffer and waits for all of them; results hold the
+    // byte count or a negated errno.
+    void read(
+        std::span<const int>             descriptors,
+        std::span<const std::uint64_t>   offsets,
+        std::span<const std::span<char>> buffers,
+        std::span<std::int64_t>          results);
+};
+
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+namespace
+{
+    template <typename Field>
+    Field* ring_field(
+        void* const         ring,
+        const std::uint32_t offset)
+    {
+        return reinterpret_cast<Field*>(static_cast<char*>(ring) + offset);
+    }
+
+    std::uint64_t user_address(const iovec* vector)
+    {
+        return reinterpret_cast<std::uint64_t>(vector);
+    }
+} // namespace
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+UringQueue::UringQueue(const unsigned entries)
+{
+    io_uring_params params {};
+
+    // NOLINTNEXTLINE(*-vararg)
+    ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (ring_fd_ == -1)
+    {
+        throw std::system_error(errno, std::generic_category(),
+            "io_uring is not available");
+    }
+
+    try
+    {
+        map(sq_ring_, params.sq_off.array + params.sq_entries * sizeof(std::uint32_t),
+            IORING_OFF_SQ_RING);
+        map(cq_ring_, params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe),
+            IORING_OFF_CQ_RING);
+        map(sqes_, params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES);
+    }
+    catch (...)
+    {
+        close();
+        throw;
+    }
+
+    sq_tail_ = ring_field<std::uint32_t>(sq_ring_.address, params.sq_off.tail);
+    sq_mask_ = ring_field<std::uint32_t>(sq_ring_.address, params.sq_off.ring_mask);
+    sq_array_ = ring_field<std::uint32_t>(sq_ring_.address, params.sq_off.array);
+    cq_head_ = ring_field<std::uint32_t>(cq_ring_.address, params.cq_off.head);
+    cq_tail_ = ring_field<std::uint32_t>(cq_ring_.address, params.cq_off.tail);
+    cq_mask_ = ring_field<std::uint32_t>(cq_ring_.address, params.cq_off.ring_mask);
+    cqes_ = ring_field<io_uring_cqe>(cq_ring_.address, params.cq_off.cqes);
+    sqe_array_ = static_cast<io_uring_sqe*>(sqes_.address);
+    iovecs_.resize(params.sq_entries);
+}
+
+UringQueue::~UringQueue()
+{
+    close();
+}
+
+void UringQueue::close()
+{
+    for (auto* mapping : {&sqes_, &cq_ring_, &sq_ring_})
+    {
+        if (mapping->address != MAP_FAILED)
+        {
+            ::munmap(mapping->address, mapping->size);
+            mapping->address = MAP_FAILED;
+        }
+    }
+
+    if (ring_fd_ != -1)
+    {
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+    }
+}
+
+void UringQueue::map(
+    Mapping&          mapping,
+    const std::size_t size,
+    const off_t       offset) const
+{
+    mapping.address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    if (mapping.address == MAP_FAILED)
+    {
+        throw std::system_error(errno, std::generic_category(),
+            "Failed to map io_uring queues");
+    }
+
+    mapping.size = size;
+}
+
+void UringQueue::read(
+    std::span<const int>             descriptors,
+    std::span<const std::uint64_t>   offsets,
+    std::span<const std::span<char>> buffers,
+    std::span<std::int64_t>          results)
+{
+    const auto sqes = std::span(sqe_array_, iovecs_.size());
+    const auto sq_array = std::span(sq_array_, iovecs_.size());
+    const std::uint32_t sq_mask = *sq_mask_;
+    const std::uint32_t cq_mask = *cq_mask_;
+    std::uint32_t tail = *sq_tail_;
+
+    for (std::size_t index = 0; index < buffers.size(); ++index)
+    {
+        const std::uint32_t slot = tail++ & sq_mask;
+        io_uring_sqe& sqe = sqes[slot];
+
+        iovecs_[index] = {buffers[index].data(), buffers[index].size()};
+        sqe = io_uring_sqe{};
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = descriptors[index];
+        sqe.addr = user_address(&iovecs_[index]);
+        sqe.len = 1;
+        sqe.off = offsets[index];
+        sqe.user_data = index;
+        sq_array[slot] = slot;
+    }
+
+    std::atomic_ref<std::uint32_t>(*sq_tail_).store(tail, std::memory_order_release);
+
+    std::size_t submitted = 0;
+    std::size_t completed = 0;
+
+    while (completed < buffers.size())
+    {
+        // NOLINTNEXTLINE(*-vararg)
+        const long entered = ::syscall(__NR_io_uring_enter, ring_fd_,
+            buffers.size() - submitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+        if (entered == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(),
+                "Failed to submit io_uring reads");
+        }
+
+        submitted += static_cast<std::size_t>(entered);
+
+        std::uint32_t head = *cq_head_;
+        const std::uint32_t cq_tail =
+            std::atomic_ref<std::uint32_t>(*cq_tail_).load(std::memory_order_acquire);
+        const auto cqes = std::span(cqes_, std::size_t{cq_mask} + 1);
+
+        for (; head != cq_tail; ++head, ++completed)
+        {
+            const io_uring_cqe& cqe = cqes[head & cq_mask];
+
+            results[static_cast<std::size_t>(cqe.user_data)] = cqe.res;
+        }
+
+        std::atomic_ref<std::uint32_t>(*cq_head_).store(head, std::memory_order_release);
+    }
+}
+#else
+class UringQueue {};
+#endif
+
+BlockPipeline::BlockPipeline(
+    const FileTable&  table,
+    HashAlgorithm     hash_algo,
+    const std::size_t block_size,
+    const io_backend  backend,
+    const ThreadCount threads)
+    :
+    table_(table),
+    hash_algo_(std::move(hash_algo)),
+    block_size_(std::max<std::size_t>(block_size, 1)),
+    queue_depth_(std::clamp<std::size_t>(MAX_BUFFERED_BYTES / block_size_, 1,
+        MAX_QUEUE_DEPTH))
+{
+    std::size_t worker_count = std::max<std::size_t>(threads.value, 1);
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+    if (backend != io_backend::threads)
+    {
+        try
+        {
+            uring_ = std::make_unique<UringQueue>(static_cast<unsigned>(queue_depth_));
+            backend_ = io_backend::io_uring;
+        }
+        catch (const std::system_error& e)
+        {
+            if (backend == io_backend::io_uring)
+            {
+                std::cerr << "Warning: " << e.what() << ", using threads\n";
+            }
+        }
+    }
+#else
+    if (backend == io_backend::io_uring)
+    {
+        std::cerr << "Warning: io_uring is not available, using threads\n";
+    }
+#endif
+
+#if !defined(_WIN32)
+    if (backend_ == io_backend::threads)
+    {
+        worker_count = std::max(worker_count, std::min(MIN_IO_THREADS, queue_depth_));
+    }
+#else
+    worker_count = 1;
+#endif
+
+    lengths_.resize(queue_depth_);
+    workers_ = std::make_unique<WorkerPool>(worker_count);
+}
+
+BlockPipeline::~BlockPipeline() = default;
+
+void BlockPipeline::run(std::span<const Request> requests)
+{
+    while (!requests.empty())
+    {
+        const std::size_t count = std::min(requests.size(), queue_depth_);
+
+        run_batch(requests.first(count));
+        requests = requests.subspan(count);
+    }
+}
+
+void BlockPipeline::release(const FileTable::Index file)
+{
+    descriptors_.release(file);
+}
+
+io_backend BlockPipeline::backend() const
+{
+    return backend_;
+}
+
+std::size_t BlockPipeline::queue_depth() const
+{
+    return queue_depth_;
+}
+
+std::uint64_t BlockPipeline::bytes_read() const
+{
+    return bytes_read_;
+}
+
+void BlockPipeline::run_batch(std::span<const Request> batch)
+{
+    const auto buffer = [this](const std::size_t index)
+    {
+        return std::span(buffers_).subspan(index * block_size_, block_size_);
+    };
+    const auto hash = [this, &batch, &buffer](const std::size_t index)
+    {
+        const auto data = buffer(index).first(lengths_[index]);
+
+        *batch[index].digest =
+            hash_algo_.compute_hash(std::string_view(data.data(), data.size()));
+    };
+
+    // Small runs, such as refreshes in watch mode, never pay for the full queue.
+    buffers_.resize(std::max(buffers_.size(), batch.size() * block_size_));
+    for (const auto& request : batch)
+    {
+        descriptors_.open(request.file, table_.path(request.file));
+    }
+
+#if defined(_WIN32)
+    for (std::size_t index = 0; index < batch.size(); ++index)
+    {
+        lengths_[index] =
+            descriptors_.read(batch[index].file, batch[index].offset, buffer(index));
+        hash(index);
+    }
+#else
+    std::vector<int> descriptors;
+
+    descriptors.reserve(batch.size());
+    for (const auto& request : batch)
+    {
+        descriptors.emplace_back(descriptors_.descriptor(request.file));
+    }
+
+    if (uring_)
+    {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+        std::vector<std::uint64_t> offsets;
+        std::vector<std::span<char>> buffers;
+        std::vector<std::int64_t> results(batch.size());
+
+        for (std::size_t index = 0; index < batch.size(); ++index)
+        {
+            offsets.emplace_back(batch[index].offset);
+            buffers.emplace_back(buffer(index));
+        }
+
+        uring_->read(descriptors, offsets, buffers, results);
+        workers_->run(batch.size(), [&](const std::size_t index)
+        {
+            if (results[index] < 0)
+            {
+                throw std::system_error(static_cast<int>(-results[index]),
+                    std::generic_category(), "Failed to read file");
+            }
+
+            // A short read before the end of the file is finished with pread().
+            const std::uint64_t file_size = table_.file_size(batch[index].file);
+            auto length = static_cast<std::size_t>(results[index]);
+
+            if (  length != 0 && length < block_size_
+               && batch[index].offset + length < file_size)
+            {
+                length += read_at(descriptors[index], batch[index].offset + length,
+                    buffer(index).subspan(length));
+            }
+
+            lengths_[index] = length;
+            hash(index);
+        });
+#endif
+    }
+    else
+    {
+        workers_->run(batch.size(), [&](const std::size_t index)
+        {
+            lengths_[index] = read_at(descriptors[index], batch[index].offset,
+                buffer(index));
+            hash(index);
+        });
+    }
+#endif
+
+    for (std::size_t index = 0; index < batch.size(); ++index)
+    {
+        bytes_read_ += lengths_[index];
+    }
+}
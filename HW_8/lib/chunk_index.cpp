@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <chunk_index.hpp>
+#include <descriptor_pool.hpp>
+
+namespace
+{
+    constexpr std::size_t READ_SIZE = 1024 * 1024;
+    constexpr std::size_t GEAR_SIZE = 256;
+    constexpr unsigned PAIR_SHIFT = 32;
+    constexpr std::size_t DIGEST_HEX_DIGITS = 16;
+    constexpr int HEX_BASE = 16;
+
+    // Normalized chunking: a stricter mask before the average size and a looser
+    // one after it keep most chunks close to the average.
+    constexpr std::uint64_t MASK_SMALL = 0x0003590703530000U;
+    constexpr std::uint64_t MASK_LARGE = 0x0000d90003530000U;
+
+    constexpr std::array<std::uint64_t, GEAR_SIZE> make_gear_table()
+    {
+        constexpr std::uint64_t INCREMENT = 0x9e3779b97f4a7c15U;
+        constexpr std::uint64_t FIRST_MULTIPLIER = 0xbf58476d1ce4e5b9U;
+        constexpr std::uint64_t SECOND_MULTIPLIER = 0x94d049bb133111ebU;
+        constexpr unsigned FIRST_SHIFT = 30;
+        constexpr unsigned SECOND_SHIFT = 27;
+        constexpr unsigned THIRD_SHIFT = 31;
+        std::array<std::uint64_t, GEAR_SIZE> table {};
+        std::uint64_t state = 0;
+
+        for (auto& value : table)
+        {
+            state += INCREMENT;
+            value = state;
+            value = (value ^ (value >> FIRST_SHIFT)) * FIRST_MULTIPLIER;
+            value = (value ^ (value >> SECOND_SHIFT)) * SECOND_MULTIPLIER;
+            value ^= value >> THIRD_SHIFT;
+        }
+
+        return table;
+    }
+
+    constexpr std::array<std::uint64_t, GEAR_SIZE> GEAR = make_gear_table();
+
+    std::uint64_t chunk_digest(std::string_view data)
+    {
+        const std::string hex = compute_md5(data);
+        std::uint64_t digest = 0;
+
+        std::from_chars(hex.data(), hex.data() + DIGEST_HEX_DIGITS, digest, HEX_BASE);
+
+        return digest;
+    }
+} // namespace
+
+std::size_t ContentChunker::next_cut(std::span<const char> data)
+{
+    if (data.size() <= MIN_SIZE)
+    {
+        return data.size();
+    }
+
+    const std::size_t end = std::min(data.size(), MAX_SIZE);
+    const std::size_t normal = std::min(end, AVERAGE_SIZE);
+    std::uint64_t hash = 0;
+    std::size_t position = MIN_SIZE;
+
+    for (; position < normal; ++position)
+    {
+        hash = (hash << 1U) + GEAR[static_cast<unsigned char>(data[position])];
+        if ((hash & MASK_SMALL) == 0)
+        {
+            return position + 1;
+        }
+    }
+
+    for (; position < end; ++position)
+    {
+        hash = (hash << 1U) + GEAR[static_cast<unsigned char>(data[position])];
+        if ((hash & MASK_LARGE) == 0)
+        {
+            return position + 1;
+        }
+    }
+
+    return end;
+}
+
+ChunkIndex::ChunkIndex(
+    const FileTable&  table,
+    const ThreadCount threads)
+    :
+    table_(table),
+    threads_(std::max<std::size_t>(threads.value, 1)) {}
+
+void ChunkIndex::add_files(std::span<const FileTable::Index> files)
+{
+    std::vector<std::vector<Chunk>> results(std::min(threads_, files.size()));
+    std::atomic<std::size_t> next{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    const auto worker = [&](std::vector<Chunk>& chunks)
+    {
+        std::vector<char> buffer(READ_SIZE);
+
+        try
+        {
+            for (std::size_t index = next++; index < files.size(); index = next++)
+            {
+                chunk_file(files[index], chunks, buffer);
+            }
+        }
+        catch (...)
+        {
+            const std::lock_guard<std::mutex> lock(error_mutex);
+
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+
+            next = files.size();
+        }
+    };
+
+    std::vector<std::thread> workers;
+
+    for (std::size_t i = 1; i < results.size(); ++i)
+    {
+        workers.emplace_back(worker, std::ref(results[i]));
+    }
+
+    if (!results.empty())
+    {
+        worker(results.front());
+    }
+
+    for (auto& thread : workers)
+    {
+        thread.join();
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    for (auto& chunks : results)
+    {
+        chunks_.insert(chunks_.end(), chunks.begin(), chunks.end());
+    }
+
+    std::ranges::sort(chunks_, {}, [](const Chunk& chunk) noexcept
+    {
+        return std::pair(chunk.digest, chunk.file);
+    });
+}
+
+// A sorted array of (digest, file) records is the inverted index: every run of
+// equal digests is the posting list of one chunk. It takes 16 bytes per chunk
+// and no per-node allocations, unlike a hash map of vectors.
+std::vector<SimilarPair> ChunkIndex::similar_pairs(const std::uint64_t min_shared) const
+{
+    std::unordered_map<std::uint64_t, std::uint64_t> shared;
+    std::vector<SimilarPair> pairs;
+
+    for (auto begin = chunks_.begin(); begin != chunks_.end();)
+    {
+        const auto end = std::find_if(begin, chunks_.end(),
+            [&begin](const Chunk& chunk) noexcept
+            {
+                return chunk.digest != begin->digest;
+            });
+        const auto count = static_cast<std::size_t>(end - begin);
+
+        if (count > 1 && count <= MAX_FILES_PER_CHUNK)
+        {
+            for (auto first = begin; first != end; ++first)
+            {
+                for (auto second = first + 1; second != end; ++second)
+                {
+                    const std::uint64_t key = (std::uint64_t{first->file} << PAIR_SHIFT)
+                        | second->file;
+
+                    shared[key] += first->size;
+                }
+            }
+        }
+
+        begin = end;
+    }
+
+    for (const auto& [key, bytes] : shared)
+    {
+        if (bytes >= min_shared)
+        {
+            const auto first = static_cast<FileTable::Index>(key >> PAIR_SHIFT);
+            const auto second = static_cast<FileTable::Index>(key);
+
+            if (table_.path(second) < table_.path(first))
+            {
+                pairs.push_back({second, first, bytes});
+            }
+            else
+            {
+                pairs.push_back({first, second, bytes});
+            }
+        }
+    }
+
+    std::ranges::sort(pairs, [this](const SimilarPair& left, const SimilarPair& right)
+    {
+        if (left.shared_bytes != right.shared_bytes)
+        {
+            return left.shared_bytes > right.shared_bytes;
+        }
+
+        return std::pair(table_.path(left.first), table_.path(left.second))
+            < std::pair(table_.path(right.first), table_.path(right.second));
+    });
+
+    return pairs;
+}
+
+std::size_t ChunkIndex::chunk_count() const
+{
+    return chunks_.size();
+}
+
+std::uint64_t ChunkIndex::bytes_read() const
+{
+    return bytes_read_;
+}
+
+// Reads the file in large blocks and keeps at least MAX_SIZE bytes buffered
+// before every cut, so chunk boundaries do not depend on the read size.
+void ChunkIndex::chunk_file(
+    const FileTable::Index file,
+    std::vector<Chunk>&    chunks,
+    std::vector<char>&     buffer)
+{
+    DescriptorPool descriptors(1);
+    const std::size_t first_chunk = chunks.size();
+    std::uint64_t offset = 0;
+    std::size_t filled = 0;
+    bool at_end = false;
+
+    descriptors.open(file, table_.path(file));
+    while (!at_end || filled > 0)
+    {
+        if (!at_end)
+        {
+            const auto free_space = std::span(buffer).subspan(filled);
+            const std::size_t bytes_read = descriptors.read(file, offset, free_space);
+
+            offset += bytes_read;
+            filled += bytes_read;
+            at_end = bytes_read < free_space.size();
+        }
+
+        std::size_t start = 0;
+
+        while (filled - start >= ContentChunker::MAX_SIZE || (at_end && start < filled))
+        {
+            const auto data = std::span(buffer).first(filled).subspan(start);
+            const std::size_t length = ContentChunker::next_cut(data);
+
+            chunks.push_back({chunk_digest({data.data(), length}), file,
+                static_cast<std::uint32_t>(length)});
+            start += length;
+        }
+
+        std::copy(buffer.begin() + static_cast<std::ptrdiff_t>(start),
+            buffer.begin() + static_cast<std::ptrdiff_t>(filled), buffer.begin());
+        filled -= start;
+    }
+
+    bytes_read_ += offset;
+
+    // A chunk repeated inside one file is counted once when pairing files.
+    const auto file_chunks = std::span(chunks).subspan(first_chunk);
+
+    std::ranges::sort(file_chunks, {}, &Chunk::digest);
+    chunks.erase(std::unique(chunks.begin() + static_cast<std::ptrdiff_t>(first_chunk),
+        chunks.end(), [](const Chunk& left, const Chunk& right) noexcept
+        {
+            return left.digest == right.digest;
+        }), chunks.end());
+}
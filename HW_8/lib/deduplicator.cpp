@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <system_error>
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <deduplicator.hpp>
+#include <hash_cache.hpp>
+#include <path_filter.hpp>
+
+namespace
+{
+    struct ActionNames
+    {
+        std::string_view planned;
+        std::string_view done;
+    };
+
+    ActionNames action_names(const dedup_action action)
+    {
+        if (action == dedup_action::hardlink)
+        {
+            return {"Would hardlink", "Hardlinked"};
+        }
+
+        if (action == dedup_action::reflink)
+        {
+            return {"Would reflink", "Reflinked"};
+        }
+
+        return {"Would delete", "Deleted"};
+    }
+
+    // "dir/", "./dir" and "dir" all name the same scan root.
+    std::string normalized(const boost::filesystem::path& path)
+    {
+        boost::filesystem::path result = path.lexically_normal();
+
+        if (result.filename() == "." && result.has_parent_path())
+        {
+            result = result.parent_path();
+        }
+
+        return result.string();
+    }
+
+    boost::filesystem::path temporary_path(const boost::filesystem::path& target)
+    {
+        return target.parent_path() / boost::filesystem::unique_path(
+            "." + target.filename().string() + ".bayan-%%%%%%%%");
+    }
+
+    // rename() replaces the target in one step, so readers see either the old
+    // file or the new one.
+    void replace_atomically(
+        const boost::filesystem::path& temporary,
+        const boost::filesystem::path& target)
+    {
+        try
+        {
+            boost::filesystem::rename(temporary, target);
+        }
+        catch (const boost::filesystem::filesystem_error&)
+        {
+            boost::system::error_code error;
+
+            boost::filesystem::remove(temporary, error);
+            throw;
+        }
+    }
+
+#if defined(__linux__)
+    // Returns false if the file system cannot share extents between the files.
+    bool reflink_file(
+        const boost::filesystem::path& source,
+        const boost::filesystem::path& target)
+    {
+        struct stat target_info {};
+
+        if (::stat(target.c_str(), &target_info) == -1)
+        {
+            throw std::system_error(errno, std::generic_category(),
+                "Failed to stat " + target.string());
+        }
+
+        const int source_fd = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (source_fd == -1)
+        {
+            throw std::system_error(errno, std::generic_category(),
+                "Failed to open " + source.string());
+        }
+
+        constexpr mode_t PERMISSION_BITS = 07777;
+        const boost::filesystem::path temporary = temporary_path(target);
+        const int temporary_fd = ::open(temporary.c_str(),
+            O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+            target_info.st_mode & PERMISSION_BITS);
+
+        if (temporary_fd == -1)
+        {
+            const int error = errno;
+
+            ::close(source_fd);
+            throw std::system_error(error, std::generic_category(),
+                "Failed to create " + temporary.string());
+        }
+
+        if (::ioctl(temporary_fd, FICLONE, source_fd) == -1)
+        {
+            const int error = errno;
+
+            ::close(temporary_fd);
+            ::close(source_fd);
+            ::unlink(temporary.c_str());
+            if (  error == EOPNOTSUPP || error == EXDEV || error == EINVAL
+               || error == ENOTTY)
+            {
+                return false;
+            }
+
+            throw std::system_error(error, std::generic_category(),
+                "Failed to reflink " + target.string());
+        }
+
+        const std::array<timespec, 2> times
+            {target_info.st_atim, target_info.st_mtim};
+
+        static_cast<void>(
+            ::fchown(temporary_fd, target_info.st_uid, target_info.st_gid));
+        static_cast<void>(::futimens(temporary_fd, times.data()));
+        ::close(temporary_fd);
+        ::close(source_fd);
+        replace_atomically(temporary, target);
+
+        return true;
+    }
+#else
+    bool reflink_file(
+        const boost::filesystem::path& /*source*/,
+        const boost::filesystem::path& /*target*/)
+    {
+        return false;
+    }
+#endif
+} // namespace
+
+Deduplicator::Deduplicator(
+    const Options&   options,
+    const FileTable& table)
+    :
+    table_(table),
+    action_(options.action),
+    keep_(options.keep),
+    dry_run_(options.dry_run)
+{
+    scan_dirs_.reserve(options.scan_dirs.size());
+    for (const auto& dir : options.scan_dirs)
+    {
+        scan_dirs_.emplace_back(normalized(dir));
+    }
+}
+
+void Deduplicator::process(std::span<const FileTable::Index> group)
+{
+    if (action_ == dedup_action::none)
+    {
+        return;
+    }
+
+    // A symlink is neither kept nor replaced: linking to it would copy the
+    // link itself, which dangles when it is relative, and replacing it would
+    // turn it into a file of its own.
+    std::vector<FileTable::Index> files;
+
+    std::ranges::copy_if(group, std::back_inserter(files),
+        [this](const FileTable::Index file)
+        {
+            return !table_.is_symlink(file);
+        });
+    if (files.size() < 2)
+    {
+        return;
+    }
+
+    const FileTable::Index keeper = select_keeper(files);
+
+    for (const auto file : files)
+    {
+        if (file == keeper)
+        {
+            continue;
+        }
+
+        bool replaced = true;
+
+        for (auto target = file; target != FileTable::NO_INDEX;
+            target = table_.next_link(target))
+        {
+            replaced = apply(keeper, target) && replaced;
+        }
+
+        if (replaced)
+        {
+            bytes_reclaimed_ += table_.file_size(file);
+        }
+    }
+}
+
+void Deduplicator::finish() const
+{
+    if (action_ != dedup_action::none)
+    {
+        std::cerr << (dry_run_ ? "Bytes to reclaim: " : "Bytes reclaimed: ")
+            << bytes_reclaimed_ << '\n';
+    }
+}
+
+bool Deduplicator::failed() const
+{
+    return failed_;
+}
+
+FileTable::Index Deduplicator::select_keeper(
+    std::span<const FileTable::Index> group) const
+{
+    if (keep_ == keep_policy::oldest)
+    {
+        return *std::ranges::min_element(group, {},
+            [this](const FileTable::Index file)
+            {
+                const auto key = table_.key(file);
+
+                return key ? key->mtime_ns : std::numeric_limits<std::int64_t>::max();
+            });
+    }
+
+    if (keep_ == keep_policy::shortest_path)
+    {
+        return *std::ranges::min_element(group, {},
+            [this](const FileTable::Index file)
+            {
+                return table_.path(file).string().size();
+            });
+    }
+
+    return *std::ranges::min_element(group, {},
+        [this](const FileTable::Index file)
+        {
+            return scan_dir_index(file);
+        });
+}
+
+std::size_t Deduplicator::scan_dir_index(const FileTable::Index file) const
+{
+    const std::string path = normalized(table_.path(file));
+
+    for (std::size_t index = 0; index < scan_dirs_.size(); ++index)
+    {
+        if (  path == scan_dirs_[index]
+           || is_inside_directory(path, scan_dirs_[index]))
+        {
+            return index;
+        }
+    }
+
+    return scan_dirs_.size();
+}
+
+bool Deduplicator::is_unchanged(const FileTable::Index file) const
+{
+    const auto expected = table_.key(file);
+    const auto current = query_file_key(table_.path(file));
+
+    if (!expected || !current)
+    {
+        return !expected && !current;
+    }
+
+    return current->device == expected->device
+        && current->inode == expected->inode
+        && current->size == expected->size
+        && current->mtime_ns == expected->mtime_ns;
+}
+
+bool Deduplicator::apply(
+    const FileTable::Index keeper,
+    const FileTable::Index target)
+{
+    const boost::filesystem::path keeper_path = table_.path(keeper);
+    const boost::filesystem::path target_path = table_.path(target);
+    const ActionNames names = action_names(action_);
+
+    if (dry_run_)
+    {
+        std::cerr << names.planned << ' ' << target_path.string() << " (keeping "
+            << keeper_path.string() << ")\n";
+
+        return true;
+    }
+
+    if (!is_unchanged(keeper) || !is_unchanged(target))
+    {
+        std::cerr << "Warning: File changed after scanning, left unchanged: "
+            << target_path.string() << '\n';
+
+        return false;
+    }
+
+    try
+    {
+        if (action_ == dedup_action::remove)
+        {
+            boost::filesystem::remove(target_path);
+        }
+        else if (action_ == dedup_action::hardlink)
+        {
+            const boost::filesystem::path temporary = temporary_path(target_path);
+
+            boost::filesystem::create_hard_link(keeper_path, temporary);
+            replace_atomically(temporary, target_path);
+        }
+        else if (!reflink_file(keeper_path, target_path))
+        {
+            std::cerr << "Warning: File system does not support reflinks, left "
+                "unchanged: " << target_path.string() << '\n';
+
+            return false;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << '\n';
+        failed_ = true;
+
+        return false;
+    }
+
+    std::cerr << names.done << ' ' << target_path.string() << " (keeping "
+        << keeper_path.string() << ")\n";
+
+    return true;
+}
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <descriptor_pool.hpp>
+
+#if !defined(_WIN32)
+std::size_t read_at(
+    const int           descriptor,
+    const std::uint64_t offset,
+    std::span<char>     buffer)
+{
+    std::size_t total = 0;
+
+    while (total < buffer.size())
+    {
+        const auto remaining = buffer.subspan(total);
+        const ssize_t bytes_read = ::pread(descriptor, remaining.data(),
+            remaining.size(), static_cast<off_t>(offset + total));
+
+        if (bytes_read == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(),
+                "Failed to read file");
+        }
+
+        if (bytes_read == 0)
+        {
+            break;
+        }
+
+        total += static_cast<std::size_t>(bytes_read);
+    }
+
+    return total;
+}
+#endif
+
+DescriptorPool::DescriptorPool(const std::size_t capacity)
+    :
+    capacity_(std::max<std::size_t>(capacity, 1)) {}
+
+DescriptorPool::~DescriptorPool()
+{
+    clear();
+}
+
+bool DescriptorPool::contains(const std::size_t owner) const
+{
+    return slots_.contains(owner);
+}
+
+void DescriptorPool::open(
+    const std::size_t              owner,
+    const boost::filesystem::path& path)
+{
+    if (const auto iterator = slots_.find(owner); iterator != slots_.end())
+    {
+        iterator->second.last_use = ++clock_;
+
+        return;
+    }
+
+    if (slots_.size() >= capacity_)
+    {
+        evict();
+    }
+
+#if defined(_WIN32)
+    std::ifstream stream(path.string(), std::ios::binary);
+
+    if (!stream)
+    {
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+
+    slots_.emplace(owner, Slot{++clock_, std::move(stream)});
+#else
+    const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (descriptor == -1)
+    {
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+
+    slots_.emplace(owner, Slot{++clock_, descriptor});
+#endif
+}
+
+std::size_t DescriptorPool::read(
+    const std::size_t   owner,
+    const std::uint64_t offset,
+    std::span<char>     buffer)
+{
+    const auto iterator = slots_.find(owner);
+
+    if (iterator == slots_.end())
+    {
+        throw std::logic_error("Reading from a file that is not open");
+    }
+
+    Slot& slot = iterator->second;
+    std::size_t total = 0;
+
+    slot.last_use = ++clock_;
+#if defined(_WIN32)
+    slot.stream.clear();
+    slot.stream.seekg(static_cast<std::streamoff>(offset));
+    slot.stream.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    total = static_cast<std::size_t>(slot.stream.gcount());
+#else
+    total = read_at(slot.descriptor, offset, buffer);
+#endif
+
+    return total;
+}
+
+#if !defined(_WIN32)
+int DescriptorPool::descriptor(const std::size_t owner) const
+{
+    const auto iterator = slots_.find(owner);
+
+    if (iterator == slots_.end())
+    {
+        throw std::logic_error("Reading from a file that is not open");
+    }
+
+    return iterator->second.descriptor;
+}
+#endif
+
+void DescriptorPool::release(const std::size_t owner)
+{
+    const auto iterator = slots_.find(owner);
+
+    if (iterator == slots_.end())
+    {
+        return;
+    }
+
+#if !defined(_WIN32)
+    ::close(iterator->second.descriptor);
+#endif
+    slots_.erase(iterator);
+}
+
+void DescriptorPool::clear()
+{
+#if !defined(_WIN32)
+    for (const auto& [owner, slot] : slots_)
+    {
+        ::close(slot.descriptor);
+    }
+#endif
+
+    slots_.clear();
+}
+
+void DescriptorPool::evict()
+{
+    const auto oldest = std::ranges::min_element(slots_, {},
+        [](const auto& slot) noexcept
+        {
+            return slot.second.last_use;
+        });
+
+    if (oldest != slots_.end())
+    {
+        release(oldest->first);
+    }
+}
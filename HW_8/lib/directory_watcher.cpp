@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#if !defined(_WIN32) && !defined(_MSC_VER)
+#include <csignal>
+#endif
+#if defined(__linux__)
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <directory_watcher.hpp>
+
+namespace
+{
+    [[nodiscard]] DirectoryWatcher*& get_watcher_instance() noexcept
+    {
+        static DirectoryWatcher* instance = nullptr; // NOLINT(misc-const-correctness)
+
+        return instance;
+    }
+
+#if !defined(_WIN32) && !defined(_MSC_VER)
+    void signal_handler(const int /*signal*/)
+    {
+        if (auto* instance = get_watcher_instance(); instance)
+        {
+            instance->stop();
+        }
+    }
+#endif
+
+    void append_changes(
+        std::vector<DuplicateIndex::Change>& changes,
+        std::vector<DuplicateIndex::Change>  new_changes)
+    {
+        changes.insert(changes.end(), std::make_move_iterator(new_changes.begin()),
+            std::make_move_iterator(new_changes.end()));
+    }
+} // namespace
+
+DirectoryWatcher::DirectoryWatcher(
+    const Options&  options,
+    DuplicateIndex& index)
+    :
+    index_(index),
+    file_masks_(options.file_masks),
+    exclude_dirs_(options.exclude_dirs),
+    scan_dirs_(options.scan_dirs),
+    min_file_size_(options.min_file_size),
+    scan_level_(options.scan_level),
+    format_(options.format),
+    separator_(options.print0 ? '\0' : '\n') {}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+#if defined(__linux__)
+    if (inotify_fd_ != -1)
+    {
+        ::close(inotify_fd_);
+    }
+#endif
+
+    if (get_watcher_instance() == this)
+    {
+        get_watcher_instance() = nullptr;
+    }
+}
+
+void DirectoryWatcher::stop() noexcept
+{
+    stopped_ = true;
+}
+
+void DirectoryWatcher::setup_signal_handling()
+{
+    get_watcher_instance() = this;
+#if !defined(_WIN32) && !defined(_MSC_VER)
+    struct sigaction sigaction_info {};
+
+    sigaction_info.sa_handler = signal_handler;
+    sigemptyset(&sigaction_info.sa_mask);
+    sigaction_info.sa_flags = 0;
+    if (sigaction(SIGHUP, &sigaction_info, nullptr) == -1)
+    {
+        std::cerr << "Failed to register SIGHUP handler, but continue anyway\n";
+    }
+
+    if (sigaction(SIGINT, &sigaction_info, nullptr) == -1)
+    {
+        std::cerr << "Failed to register SIGINT handler, but continue anyway\n";
+    }
+
+    if (sigaction(SIGQUIT, &sigaction_info, nullptr) == -1)
+    {
+        std::cerr << "Failed to register SIGQUIT handler, but continue anyway\n";
+    }
+
+    if (sigaction(SIGTERM, &sigaction_info, nullptr) == -1)
+    {
+        std::cerr << "Failed to register SIGTERM handler, but continue anyway\n";
+    }
+#endif
+}
+
+ProcessStatus DirectoryWatcher::run()
+{
+#if defined(__linux__)
+    constexpr int POLL_TIMEOUT_MS = 500;
+    constexpr std::size_t EVENT_BUFFER_SIZE = 65536;
+    std::vector<DuplicateIndex::Change> changes;
+
+    inotify_fd_ = ::inotify_init1(IN_CLOEXEC);
+    if (inotify_fd_ == -1)
+    {
+        std::cerr << "Error: Failed to initialize inotify: "
+            << std::error_code(errno, std::generic_category()).message() << '\n';
+
+        return ProcessStatus::FILE_ERROR;
+    }
+
+    for (const auto& dir_str : scan_dirs_)
+    {
+        const boost::filesystem::path dir(dir_str);
+
+        if (boost::filesystem::is_directory(dir) && !is_excluded(dir))
+        {
+            add_watch(dir, false, changes);
+        }
+    }
+
+    std::cout << std::flush;
+
+    std::vector<char> buffer(EVENT_BUFFER_SIZE);
+
+    while (!stopped_)
+    {
+        pollfd descriptor {inotify_fd_, POLLIN, 0};
+        const int ready = ::poll(&descriptor, 1, POLL_TIMEOUT_MS);
+
+        if (ready == -1 && errno != EINTR)
+        {
+            std::cerr << "Error: Failed to wait for file system events: "
+                << std::error_code(errno, std::generic_category()).message() << '\n';
+
+            return ProcessStatus::FILE_ERROR;
+        }
+
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        const auto bytes_read = ::read(inotify_fd_, buffer.data(), buffer.size());
+
+        if (bytes_read <= 0)
+        {
+            continue;
+        }
+
+        const std::string_view events(buffer.data(),
+            static_cast<std::size_t>(bytes_read));
+        std::size_t offset = 0;
+
+        while (offset + sizeof(inotify_event) <= events.size())
+        {
+            std::array<char, sizeof(inotify_event)> header {};
+
+            std::ranges::copy(events.substr(offset, header.size()), header.begin());
+
+            const auto event = std::bit_cast<inotify_event>(header);
+            std::string_view name = events.substr(offset + header.size(), event.len);
+
+            name = name.substr(0, name.find('\0'));
+            offset += header.size() + event.len;
+
+            try
+            {
+                handle_event(event.wd, event.mask, name, changes);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Error: " << e.what() << '\n';
+            }
+        }
+
+        print_changes(changes);
+        changes.clear();
+    }
+#else
+    std::cerr << "Warning: --watch is supported only on Linux\n";
+#endif
+
+    return ProcessStatus::SUCCESS;
+}
+
+#if defined(__linux__)
+void DirectoryWatcher::add_watch(
+    const boost::filesystem::path&       dir,
+    const bool                           index_files,
+    std::vector<DuplicateIndex::Change>& changes)
+{
+    constexpr std::uint32_t WATCH_MASK =
+        IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+    const int watch = ::inotify_add_watch(inotify_fd_, dir.c_str(), WATCH_MASK);
+
+    if (watch == -1)
+    {
+        std::cerr << "Warning: Failed to watch directory " << dir << ": "
+            << std::error_code(errno, std::generic_category()).message() << '\n';
+
+        return;
+    }
+
+    // inotify returns the same descriptor for a directory reached again through
+    // another path; it stays watched under the first one.
+    if (const auto [iterator, inserted] = watches_.try_emplace(watch, dir);
+        !inserted && iterator->second != dir)
+    {
+        return;
+    }
+
+    boost::system::error_code error;
+
+    for (boost::filesystem::directory_iterator iterator(dir, error), end;
+        !error && iterator != end; iterator.increment(error))
+    {
+        const boost::filesystem::path& path = iterator->path();
+        const auto link_status = iterator->symlink_status();
+
+        if (boost::filesystem::is_directory(link_status))
+        {
+            if (scan_level_ && !is_excluded(path))
+            {
+                add_watch(path, index_files, changes);
+            }
+        }
+        else if (  boost::filesystem::is_symlink(link_status)
+                && boost::filesystem::is_directory(iterator->status()))
+        {
+            add_link_watch(path, index_files, changes);
+        }
+        else if (index_files)
+        {
+            update_file(path, changes);
+        }
+    }
+}
+
+// Follows a symlinked directory once per (device, inode), like the first scan.
+void DirectoryWatcher::add_link_watch(
+    const boost::filesystem::path&       link,
+    const bool                           index_files,
+    std::vector<DuplicateIndex::Change>& changes)
+{
+    struct stat info {};
+
+    if (  !scan_level_
+       || is_excluded(link)
+       || ::stat(link.c_str(), &info) != 0
+       || !S_ISDIR(info.st_mode))
+    {
+        return;
+    }
+
+    if (linked_dirs_.try_emplace({info.st_dev, info.st_ino}, link).second)
+    {
+        add_watch(link, index_files, changes);
+    }
+}
+
+void DirectoryWatcher::remove_watch(const boost::filesystem::path& dir)
+{
+    const std::string dir_string = dir.string();
+    const auto is_removed = [&dir, &dir_string](const boost::filesystem::path& path)
+    {
+        return path == dir || is_inside_directory(path.string(), dir_string);
+    };
+
+    std::erase_if(watches_, [this, &is_removed](const auto& watch)
+    {
+        if (!is_removed(watch.second))
+        {
+            return false;
+        }
+
+        ::inotify_rm_watch(inotify_fd_, watch.first);
+
+        return true;
+    });
+    std::erase_if(linked_dirs_, [&is_removed](const auto& linked_dir)
+    {
+        return is_removed(linked_dir.second);
+    });
+}
+
+void DirectoryWatcher::handle_event(
+    const int                            watch,
+    const std::uint32_t                  mask,
+    std::string_view                     name,
+    std::vector<DuplicateIndex::Change>& changes)
+{
+    if ((mask & IN_Q_OVERFLOW) != 0)
+    {
+        std::cerr << "Warning: Too many file system events, some changes were missed\n";
+
+        return;
+    }
+
+    const auto iterator = watches_.find(watch);
+
+    if (iterator == watches_.cend())
+    {
+        return;
+    }
+
+    if ((mask & IN_IGNORED) != 0)
+    {
+        watches_.erase(iterator);
+
+        return;
+    }
+
+    const boost::filesystem::path path = iterator->second / std::string(name);
+
+    if ((mask & IN_ISDIR) != 0)
+    {
+        if ((mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+        {
+            if (scan_level_ && !is_excluded(path))
+            {
+                add_watch(path, true, changes);
+            }
+        }
+        else if ((mask & IN_MOVED_FROM) != 0)
+        {
+            remove_watch(path);
+            append_changes(changes, index_.remove_directory(path));
+        }
+
+        return;
+    }
+
+    boost::system::error_code error;
+
+    if ((mask & (IN_CREATE | IN_MOVED_TO)) != 0
+       && boost::filesystem::is_symlink(boost::filesystem::symlink_status(path, error))
+       && boost::filesystem::is_directory(boost::filesystem::status(path, error)))
+    {
+        add_link_watch(path, true, changes);
+    }
+    else if ((mask & (IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO)) != 0)
+    {
+        update_file(path, changes);
+    }
+    else if ((mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+    {
+        if (std::ranges::any_of(linked_dirs_,
+            [&path](const auto& linked_dir) noexcept
+            {
+                return linked_dir.second == path;
+            }))
+        {
+            remove_watch(path);
+            append_changes(changes, index_.remove_directory(path));
+        }
+        else
+        {
+            append_changes(changes, index_.remove(path));
+        }
+    }
+}
+#else
+void DirectoryWatcher::add_watch(
+    const boost::filesystem::path&       /*dir*/,
+    const bool                           /*index_files*/,
+    std::vector<DuplicateIndex::Change>& /*changes*/) {}
+
+void DirectoryWatcher::add_link_watch(
+    const boost::filesystem::path&       /*link*/,
+    const bool                           /*index_files*/,
+    std::vector<DuplicateIndex::Change>& /*changes*/) {}
+
+void DirectoryWatcher::remove_watch(const boost::filesystem::path& /*dir*/) {}
+
+void DirectoryWatcher::handle_event(
+    const int                            /*watch*/,
+    const std::uint32_t                  /*mask*/,
+    std::string_view                     /*name*/,
+    std::vector<DuplicateIndex::Change>& /*changes*/) {}
+#endif
+
+void DirectoryWatcher::update_file(
+    const boost::filesystem::path&       path,
+    std::vector<DuplicateIndex::Change>& changes)
+{
+    boost::system::error_code error;
+    const auto status = boost::filesystem::status(path, error);
+
+    if (  !error
+       && boost::filesystem::is_regular_file(status)
+       && file_masks_.matches(path.filename().string()))
+    {
+        const uintmax_t size = boost::filesystem::file_size(path, error);
+
+        if (!error && size >= min_file_size_)
+        {
+            append_changes(changes, index_.add(path, size));
+
+            return;
+        }
+    }
+
+    append_changes(changes, index_.remove(path));
+}
+
+bool DirectoryWatcher::is_excluded(const boost::filesystem::path& dir) const
+{
+    return exclude_dirs_.is_excluded(exclude_dirs_.find(dir));
+}
+
+// Follows --output_format and --print0 like the groups of the first pass.
+void DirectoryWatcher::print_changes(
+    const std::vector<DuplicateIndex::Change>& changes) const
+{
+    if (changes.empty())
+    {
+        return;
+    }
+
+    for (const auto& change : changes)
+    {
+        if (format_ == output_format::ndjson)
+        {
+            const char *separator = "";
+
+            std::cout << R"({"type":")" << (change.formed ? "formed" : "broken")
+                << R"(","paths":[)";
+            for (const auto& path : change.paths)
+            {
+                std::cout << separator << '"' << json_escape(path) << '"';
+                separator = ",";
+            }
+
+            std::cout << "]}\n";
+            continue;
+        }
+
+        std::cout << (change.formed ? "Duplicate group formed:"
+            : "Duplicate group broken:") << separator_;
+        for (const auto& path : change.paths)
+        {
+            std::cout << path << separator_;
+        }
+
+        std::cout << separator_;
+    }
+
+    std::cout << std::flush;
+}
@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <numeric>
+#include <ranges>
+#include <stdexcept>
+
+#include <file_table.hpp>
+
+namespace
+{
+    // Orders names the way full paths are ordered, so a directory compares as
+    // its name followed by a separator.
+    bool name_less(
+        std::string_view lhs,
+        const bool       lhs_directory,
+        std::string_view rhs,
+        const bool       rhs_directory)
+    {
+        constexpr int SEPARATOR = '/';
+        constexpr int END = -1;
+        const auto character_at = [](std::string_view name, const bool is_directory,
+            const std::size_t position) noexcept
+        {
+            if (position < name.size())
+            {
+                return static_cast<int>(static_cast<unsigned char>(name[position]));
+            }
+
+            return position == name.size() && is_directory ? SEPARATOR : END;
+        };
+        const std::size_t common = std::min(lhs.size(), rhs.size());
+
+        if (const int result = lhs.substr(0, common).compare(rhs.substr(0, common));
+            result != 0)
+        {
+            return result < 0;
+        }
+
+        for (std::size_t position = common; ; ++position)
+        {
+            const int lhs_character = character_at(lhs, lhs_directory, position);
+            const int rhs_character = character_at(rhs, rhs_directory, position);
+
+            if (lhs_character != rhs_character || lhs_character == END)
+            {
+                return lhs_character < rhs_character;
+            }
+        }
+    }
+} // namespace
+
+std::uint32_t FileTable::intern_name(std::string_view name)
+{
+    if (names_.size() + name.size() > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::length_error("File table name storage is full");
+    }
+
+    const auto offset = static_cast<std::uint32_t>(names_.size());
+
+    names_ += name;
+
+    return offset;
+}
+
+FileTable::Index FileTable::add_directory(
+    const Index      parent,
+    std::string_view name)
+{
+    if (directory_parent_.size() >= NO_INDEX)
+    {
+        throw std::length_error("Too many directories in file table");
+    }
+
+    const auto directory = static_cast<Index>(directory_parent_.size());
+
+    directory_name_offset_.emplace_back(intern_name(name));
+    directory_name_length_.emplace_back(static_cast<std::uint32_t>(name.size()));
+    directory_parent_.emplace_back(parent);
+
+    return directory;
+}
+
+FileTable::Index FileTable::add_file(
+    const Index         directory,
+    std::string_view    name,
+    const std::uint64_t size)
+{
+    if (file_size_.size() >= NO_INDEX)
+    {
+        throw std::length_error("Too many files in file table");
+    }
+
+    if (name.size() > std::numeric_limits<std::uint16_t>::max())
+    {
+        throw std::length_error("File name is too long: " + std::string(name));
+    }
+
+    const auto file = static_cast<Index>(file_size_.size());
+
+    file_name_offset_.emplace_back(intern_name(name));
+    file_name_length_.emplace_back(static_cast<std::uint16_t>(name.size()));
+    file_directory_.emplace_back(directory);
+    file_size_.emplace_back(size);
+    device_.emplace_back(0);
+    inode_.emplace_back(0);
+    mtime_ns_.emplace_back(0);
+    flags_.emplace_back(0);
+    next_link_.emplace_back(NO_INDEX);
+    digest_slot_.emplace_back(NO_INDEX);
+
+    return file;
+}
+
+void FileTable::set_key(
+    const Index    file,
+    const FileKey& key)
+{
+    device_[file] = key.device;
+    inode_[file] = key.inode;
+    mtime_ns_[file] = key.mtime_ns;
+    flags_[file] |= HAS_KEY;
+}
+
+void FileTable::add_link(
+    const Index file,
+    const Index link)
+{
+    Index tail = file;
+
+    while (next_link_[tail] != NO_INDEX)
+    {
+        tail = next_link_[tail];
+    }
+
+    next_link_[tail] = link;
+    flags_[link] |= IS_LINK;
+}
+
+void FileTable::mark_symlink(const Index file)
+{
+    flags_[file] |= IS_SYMLINK;
+}
+
+void FileTable::remove(const Index file)
+{
+    release_digests(file);
+    flags_[file] |= REMOVED;
+}
+
+void FileTable::unlink(const Index file)
+{
+    Index current = file;
+
+    while (current != NO_INDEX)
+    {
+        const Index next = next_link_[current];
+
+        next_link_[current] = NO_INDEX;
+        flags_[current] &= static_cast<std::uint8_t>(~IS_LINK);
+        current = next;
+    }
+}
+
+std::size_t FileTable::size() const noexcept
+{
+    return file_size_.size();
+}
+
+boost::filesystem::path FileTable::path(const Index file) const
+{
+    boost::filesystem::path result = directory_path(file_directory_[file]);
+
+    result /= names_.substr(file_name_offset_[file], file_name_length_[file]);
+
+    return result;
+}
+
+boost::filesystem::path FileTable::directory_path(const Index directory) const
+{
+    std::vector<Index> chain;
+    boost::filesystem::path result;
+
+    for (Index current = directory; current != NO_INDEX;
+        current = directory_parent_[current])
+    {
+        chain.emplace_back(current);
+    }
+
+    for (const auto current : std::ranges::reverse_view(chain))
+    {
+        result /= names_.substr(directory_name_offset_[current],
+            directory_name_length_[current]);
+    }
+
+    return result;
+}
+
+std::uint64_t FileTable::file_size(const Index file) const
+{
+    return file_size_[file];
+}
+
+std::optional<FileKey> FileTable::key(const Index file) const
+{
+    if ((flags_[file] & HAS_KEY) == 0)
+    {
+        return std::nullopt;
+    }
+
+    return FileKey{device_[file], inode_[file], file_size_[file], mtime_ns_[file]};
+}
+
+FileTable::Index FileTable::next_link(const Index file) const
+{
+    return next_link_[file];
+}
+
+bool FileTable::is_link(const Index file) const
+{
+    return (flags_[file] & IS_LINK) != 0;
+}
+
+bool FileTable::is_removed(const Index file) const
+{
+    return (flags_[file] & REMOVED) != 0;
+}
+
+bool FileTable::is_symlink(const Index file) const
+{
+    return (flags_[file] & IS_SYMLINK) != 0;
+}
+
+std::span<std::string> FileTable::digests(
+    const Index       file,
+    const std::size_t block_count)
+{
+    if (digest_slot_[file] == NO_INDEX)
+    {
+        if (free_digest_slots_.empty())
+        {
+            digest_slot_[file] = static_cast<Index>(digests_.size());
+            digests_.emplace_back(block_count);
+        }
+        else
+        {
+            digest_slot_[file] = free_digest_slots_.back();
+            free_digest_slots_.pop_back();
+            digests_[digest_slot_[file]].resize(block_count);
+        }
+    }
+
+    return digests_[digest_slot_[file]];
+}
+
+std::span<const std::string> FileTable::find_digests(const Index file) const
+{
+    if (digest_slot_[file] == NO_INDEX)
+    {
+        return {};
+    }
+
+    return digests_[digest_slot_[file]];
+}
+
+void FileTable::release_digests(const Index file)
+{
+    if (digest_slot_[file] == NO_INDEX)
+    {
+        return;
+    }
+
+    digests_[digest_slot_[file]] = {};
+    free_digest_slots_.emplace_back(digest_slot_[file]);
+    digest_slot_[file] = NO_INDEX;
+}
+
+std::string_view FileTable::entry_name(const Entry& entry) const
+{
+    const std::string_view names(names_);
+
+    if (entry.is_directory)
+    {
+        return names.substr(directory_name_offset_[entry.index],
+            directory_name_length_[entry.index]);
+    }
+
+    return names.substr(file_name_offset_[entry.index], file_name_length_[entry.index]);
+}
+
+std::vector<FileTable::Index> FileTable::sorted_files() const
+{
+    std::vector<std::size_t> offsets(directory_parent_.size() + 1, 0);
+    std::vector<Entry> entries;
+    std::vector<Entry> roots;
+    std::vector<Index> files;
+
+    for (Index file = 0; file < file_size_.size(); ++file)
+    {
+        if ((flags_[file] & REMOVED) == 0)
+        {
+            ++offsets[file_directory_[file] + 1];
+        }
+    }
+
+    for (Index directory = 0; directory < directory_parent_.size(); ++directory)
+    {
+        if (directory_parent_[directory] == NO_INDEX)
+        {
+            roots.push_back({directory, true});
+        }
+        else
+        {
+            ++offsets[directory_parent_[directory] + 1];
+        }
+    }
+
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    entries.resize(offsets.back());
+
+    {
+        std::vector<std::size_t> cursors(offsets.begin(), offsets.end() - 1);
+
+        for (Index file = 0; file < file_size_.size(); ++file)
+        {
+            if ((flags_[file] & REMOVED) == 0)
+            {
+                entries[cursors[file_directory_[file]]++] = {file, false};
+            }
+        }
+
+        for (Index directory = 0; directory < directory_parent_.size(); ++directory)
+        {
+            if (directory_parent_[directory] != NO_INDEX)
+            {
+                entries[cursors[directory_parent_[directory]]++] = {directory, true};
+            }
+        }
+    }
+
+    const auto entry_less = [this](const Entry& lhs, const Entry& rhs)
+    {
+        return name_less(entry_name(lhs), lhs.is_directory, entry_name(rhs),
+            rhs.is_directory);
+    };
+
+    for (std::size_t directory = 0; directory + 1 < offsets.size(); ++directory)
+    {
+        std::ranges::sort(std::span(entries).subspan(offsets[directory],
+            offsets[directory + 1] - offsets[directory]), entry_less);
+    }
+
+    std::ranges::sort(roots, entry_less);
+
+    std::vector<std::pair<std::size_t, std::size_t>> stack;
+
+    files.reserve(entries.size());
+    for (const auto& root : roots)
+    {
+        stack.emplace_back(offsets[root.index], offsets[root.index + 1]);
+        while (!stack.empty())
+        {
+            auto& [position, end] = stack.back();
+
+            if (position == end)
+            {
+                stack.pop_back();
+                continue;
+            }
+
+            const Entry entry = entries[position++];
+
+            if (entry.is_directory)
+            {
+                stack.emplace_back(offsets[entry.index], offsets[entry.index + 1]);
+            }
+            else
+            {
+                files.emplace_back(entry.index);
+            }
+        }
+    }
+
+    return files;
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include <group_verifier.hpp>
+
+namespace
+{
+    // Chunks are a multiple of the page size, so every read starts at an aligned
+    // offset.
+    constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+    constexpr std::size_t GROUPS_PER_THREAD = 16;
+} // namespace
+
+GroupVerifier::GroupVerifier(
+    const FileTable&  table,
+    const ThreadCount threads,
+    GroupHandler      on_group)
+    :
+    table_(table),
+    on_group_(std::move(on_group)),
+    threads_(std::max<std::size_t>(threads.value, 1)) {}
+
+void GroupVerifier::add(std::span<const FileTable::Index> group)
+{
+    pending_.emplace_back(group.begin(), group.end());
+    if (pending_.size() >= threads_ * GROUPS_PER_THREAD)
+    {
+        flush();
+    }
+}
+
+void GroupVerifier::finish()
+{
+    flush();
+}
+
+std::uint64_t GroupVerifier::bytes_read() const
+{
+    return bytes_read_;
+}
+
+void GroupVerifier::flush()
+{
+    std::vector<std::vector<std::vector<FileTable::Index>>> results(pending_.size());
+    std::atomic<std::size_t> next{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    const auto worker = [&]()
+    {
+        Reader reader;
+
+        reader.representative.resize(CHUNK_SIZE);
+        reader.member.resize(CHUNK_SIZE);
+        try
+        {
+            for (std::size_t index = next++; index < pending_.size(); index = next++)
+            {
+                results[index] = verify_group(pending_[index], reader);
+            }
+        }
+        catch (...)
+        {
+            const std::lock_guard<std::mutex> lock(error_mutex);
+
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+
+            next = pending_.size();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    const std::size_t thread_count = std::min(threads_, pending_.size());
+
+    for (std::size_t i = 1; i < thread_count; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+    for (auto& thread : workers)
+    {
+        thread.join();
+    }
+
+    pending_.clear();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    for (const auto& groups : results)
+    {
+        for (const auto& group : groups)
+        {
+            on_group_(group);
+        }
+    }
+}
+
+std::vector<std::vector<FileTable::Index>> GroupVerifier::verify_group(
+    const std::vector<FileTable::Index>& group,
+    Reader&                              reader)
+{
+    std::vector<std::vector<FileTable::Index>> groups;
+    std::vector<FileTable::Index> remaining = group;
+
+    while (!remaining.empty())
+    {
+        std::vector<FileTable::Index> different;
+
+        if (remaining.size() > 1)
+        {
+            different = split_group(remaining, reader);
+        }
+
+        if (  remaining.size() > 1
+           || table_.next_link(remaining.front()) != FileTable::NO_INDEX)
+        {
+            groups.emplace_back(std::move(remaining));
+        }
+
+        remaining = std::move(different);
+    }
+
+    reader.descriptors.clear();
+
+    return groups;
+}
+
+std::vector<FileTable::Index> GroupVerifier::split_group(
+    std::vector<FileTable::Index>& group,
+    Reader&                        reader)
+{
+    const FileTable::Index representative = group.front();
+    std::vector<FileTable::Index> different;
+
+    for (std::uint64_t offset = 0; group.size() > 1; offset += CHUNK_SIZE)
+    {
+        const std::size_t length =
+            read_chunk(representative, offset, reader.representative, reader);
+        const auto expected = std::span(reader.representative).first(length);
+        std::vector<FileTable::Index> same {representative};
+
+        for (const auto file : std::span(group).subspan(1))
+        {
+            const std::size_t member_length =
+                read_chunk(file, offset, reader.member, reader);
+
+            if (  member_length == length
+               && std::ranges::equal(std::span(reader.member).first(length), expected))
+            {
+                same.emplace_back(file);
+            }
+            else
+            {
+                different.emplace_back(file);
+            }
+        }
+
+        group = std::move(same);
+        if (length < CHUNK_SIZE)
+        {
+            break;
+        }
+    }
+
+    return different;
+}
+
+std::size_t GroupVerifier::read_chunk(
+    const FileTable::Index file,
+    const std::uint64_t    offset,
+    std::vector<char>&     buffer,
+    Reader&                reader)
+{
+    if (!reader.descriptors.contains(file))
+    {
+        reader.descriptors.open(file, table_.path(file));
+    }
+
+    const std::size_t length = reader.descriptors.read(file, offset, buffer);
+
+    bytes_read_ += length;
+
+    return length;
+}
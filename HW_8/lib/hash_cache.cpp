@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <utility>
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+#include <hash_cache.hpp>
+#include <wrapper_boost_filesystem.hpp>
+
+namespace
+{
+    constexpr std::string_view CACHE_MAGIC = "BAYANHC1";
+    constexpr std::size_t U8_BYTES = 1;
+    constexpr std::size_t U64_BYTES = 8;
+
+    void put_integer(
+        std::string&      out,
+        std::uint64_t     value,
+        const std::size_t bytes)
+    {
+        constexpr unsigned BITS_PER_BYTE = 8;
+        constexpr std::uint64_t BYTE_MASK = 0xFF;
+
+        for (std::size_t i = 0; i < bytes; ++i)
+        {
+            out.push_back(static_cast<char>(value & BYTE_MASK));
+            value >>= BITS_PER_BYTE;
+        }
+    }
+
+    class CacheReader
+    {
+        std::string_view data_;
+        std::size_t position_{0};
+    public:
+        explicit CacheReader(std::string_view data) : data_(data) {}
+
+        bool get_integer(
+            std::uint64_t&    value,
+            const std::size_t bytes)
+        {
+            constexpr unsigned BITS_PER_BYTE = 8;
+
+            if (data_.size() - position_ < bytes)
+            {
+                return false;
+            }
+
+            value = 0;
+            for (std::size_t i = bytes; i > 0; --i)
+            {
+                value <<= BITS_PER_BYTE;
+                value |= static_cast<unsigned char>(data_[position_ + i - 1]);
+            }
+
+            position_ += bytes;
+
+            return true;
+        }
+
+        bool get_bytes(
+            std::string&      value,
+            const std::size_t length)
+        {
+            if (data_.size() - position_ < length)
+            {
+                return false;
+            }
+
+            value = data_.substr(position_, length);
+            position_ += length;
+
+            return true;
+        }
+
+        [[nodiscard]] bool at_end() const noexcept
+        {
+            return position_ == data_.size();
+        }
+    };
+} // namespace
+
+std::optional<FileKey> query_file_key(const boost::filesystem::path& path)
+{
+    std::optional<FileKey> key;
+#if !defined(_WIN32)
+    constexpr std::int64_t NANOSECONDS_PER_SECOND = 1'000'000'000;
+    struct stat info {};
+
+    if (::stat(path.c_str(), &info) == 0)
+    {
+        key.emplace();
+        key->device = info.st_dev;
+        key->inode = info.st_ino;
+        key->size = static_cast<std::uint64_t>(info.st_size);
+        key->mtime_ns = info.st_mtim.tv_sec * NANOSECONDS_PER_SECOND
+            + info.st_mtim.tv_nsec;
+    }
+#else
+    static_cast<void>(path);
+#endif
+
+    return key;
+}
+
+std::size_t HashCache::EntryKeyHash::operator()(const EntryKey& key) const noexcept
+{
+    constexpr std::size_t GOLDEN_RATIO = 0x9E3779B97F4A7C15U;
+    constexpr unsigned LEFT_SHIFT = 6;
+    constexpr unsigned RIGHT_SHIFT = 2;
+    std::size_t seed = std::hash<std::uint64_t>{}(key.inode);
+
+    for (const std::uint64_t value :
+        {key.device, key.block_size, std::uint64_t{std::to_underlying(key.algorithm)}})
+    {
+        seed ^= std::hash<std::uint64_t>{}(value) + GOLDEN_RATIO + (seed << LEFT_SHIFT)
+            + (seed >> RIGHT_SHIFT);
+    }
+
+    return seed;
+}
+
+HashCache::HashCache(
+    std::string          path,
+    const std::uint64_t  block_size,
+    const hash_algorithm algorithm)
+    :
+    path_(std::move(path)),
+    block_size_(block_size),
+    algorithm_(algorithm) {}
+
+bool HashCache::load()
+{
+    entries_.clear();
+
+    if (!boost::filesystem::exists(path_))
+    {
+        return true;
+    }
+
+    boost::system::error_code error;
+    const auto file_size = boost::filesystem::file_size(path_, error);
+    std::ifstream file(path_, std::ios::binary);
+
+    if (error || !file)
+    {
+        return false;
+    }
+
+    std::string data(file_size, '\0');
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    if (file.gcount() != static_cast<std::streamsize>(data.size()))
+    {
+        return false;
+    }
+
+    CacheReader reader(data);
+    std::string magic;
+    std::uint64_t entry_count = 0;
+
+    if (  !reader.get_bytes(magic, CACHE_MAGIC.size())
+       || magic != CACHE_MAGIC
+       || !reader.get_integer(entry_count, U64_BYTES))
+    {
+        return false;
+    }
+
+    for (std::uint64_t entry_index = 0; entry_index < entry_count; ++entry_index)
+    {
+        std::uint64_t device = 0;
+        std::uint64_t inode = 0;
+        std::uint64_t size = 0;
+        std::uint64_t mtime_ns = 0;
+        std::uint64_t block_size = 0;
+        std::uint64_t algorithm = 0;
+        std::uint64_t block_count = 0;
+
+        if (  !reader.get_integer(device, U64_BYTES)
+           || !reader.get_integer(inode, U64_BYTES)
+           || !reader.get_integer(size, U64_BYTES)
+           || !reader.get_integer(mtime_ns, U64_BYTES)
+           || !reader.get_integer(block_size, U64_BYTES)
+           || !reader.get_integer(algorithm, U8_BYTES)
+           || !reader.get_integer(block_count, U64_BYTES)
+           || algorithm > std::to_underlying(hash_algorithm::md5)
+           || block_count > data.size())
+        {
+            entries_.clear();
+
+            return false;
+        }
+
+        Entry entry{size, static_cast<std::int64_t>(mtime_ns), {}};
+
+        entry.hashes.resize(block_count);
+        for (auto& hash : entry.hashes)
+        {
+            std::uint64_t length = 0;
+
+            if (  !reader.get_integer(length, U8_BYTES)
+               || !reader.get_bytes(hash, length))
+            {
+                entries_.clear();
+
+                return false;
+            }
+        }
+
+        entries_.insert_or_assign(EntryKey{device, inode, block_size,
+            static_cast<hash_algorithm>(algorithm)}, std::move(entry));
+    }
+
+    if (!reader.at_end())
+    {
+        entries_.clear();
+
+        return false;
+    }
+
+    return true;
+}
+
+bool HashCache::save() const
+{
+    std::string data(CACHE_MAGIC);
+    const auto used_count = std::ranges::count_if(entries_,
+        [](const auto& item) noexcept
+        {
+            return item.second.used;
+        });
+
+    put_integer(data, static_cast<std::uint64_t>(used_count), U64_BYTES);
+    for (const auto& [key, entry] : entries_)
+    {
+        if (!entry.used)
+        {
+            continue;
+        }
+
+        put_integer(data, key.device, U64_BYTES);
+        put_integer(data, key.inode, U64_BYTES);
+        put_integer(data, entry.size, U64_BYTES);
+        put_integer(data, static_cast<std::uint64_t>(entry.mtime_ns), U64_BYTES);
+        put_integer(data, key.block_size, U64_BYTES);
+        put_integer(data, std::to_underlying(key.algorithm), U8_BYTES);
+        put_integer(data, entry.hashes.size(), U64_BYTES);
+        for (const auto& hash : entry.hashes)
+        {
+            put_integer(data, hash.size(), U8_BYTES);
+            data += hash;
+        }
+    }
+
+    boost::system::error_code error;
+    const boost::filesystem::path target(path_);
+    const boost::filesystem::path temporary = boost::filesystem::unique_path(
+        target.string() + ".%%%%-%%%%-%%%%.tmp", error);
+
+    if (error)
+    {
+        return false;
+    }
+
+    {
+        std::ofstream file(temporary.string(), std::ios::binary | std::ios::trunc);
+
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        file.close();
+        if (!file)
+        {
+            boost::filesystem::remove(temporary, error);
+
+            return false;
+        }
+    }
+
+    boost::filesystem::rename(temporary, target, error);
+    if (error)
+    {
+        boost::filesystem::remove(temporary, error);
+
+        return false;
+    }
+
+    return true;
+}
+
+const std::vector<std::string>* HashCache::find(const FileKey& key) const
+{
+    const auto iterator = entries_.find(
+        EntryKey{key.device, key.inode, block_size_, algorithm_});
+
+    if (  iterator == entries_.cend()
+       || iterator->second.size != key.size
+       || iterator->second.mtime_ns != key.mtime_ns)
+    {
+        return nullptr;
+    }
+
+    iterator->second.used = true;
+
+    return &iterator->second.hashes;
+}
+
+void HashCache::store(
+    const FileKey&           key,
+    std::vector<std::string> hashes)
+{
+    const EntryKey entry_key{key.device, key.inode, block_size_, algorithm_};
+    const auto too_long = [](const std::string& hash) noexcept
+    {
+        return hash.size() > std::numeric_limits<std::uint8_t>::max();
+    };
+
+    // The cache keeps hash lengths in a single byte.
+    if (std::ranges::any_of(hashes, too_long))
+    {
+        entries_.erase(entry_key);
+
+        return;
+    }
+
+    entries_.insert_or_assign(entry_key,
+        Entry{key.size, key.mtime_ns, std::move(hashes), true});
+}
+
+std::size_t HashCache::size() const noexcept
+{
+    return entries_.size();
+}
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+#include <path_filter.hpp>
+
+namespace
+{
+    char to_lower(const char character) noexcept
+    {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(character)));
+    }
+} // namespace
+
+GlobMatcher::GlobMatcher(const std::vector<std::string>& masks)
+{
+    for (const auto& mask : masks)
+    {
+        Pattern pattern;
+
+        pattern.segments.emplace_back();
+        for (const char character : mask)
+        {
+            if (character == '*')
+            {
+                pattern.segments.emplace_back();
+            }
+            else
+            {
+                pattern.segments.back() += to_lower(character);
+            }
+        }
+
+        patterns_.emplace_back(std::move(pattern));
+    }
+}
+
+bool GlobMatcher::matches(std::string_view name) const
+{
+    if (patterns_.empty())
+    {
+        return true;
+    }
+
+    return std::ranges::any_of(patterns_, [name](const Pattern& pattern)
+    {
+        return matches_pattern(pattern, name);
+    });
+}
+
+bool GlobMatcher::matches_segment(
+    std::string_view segment,
+    std::string_view text)
+{
+    const auto matches_character = [](const char expected, const char actual) noexcept
+    {
+        return expected == '?' || expected == to_lower(actual);
+    };
+
+    return std::ranges::equal(segment, text, matches_character);
+}
+
+bool GlobMatcher::matches_pattern(
+    const Pattern&   pattern,
+    std::string_view name)
+{
+    const std::string_view head = pattern.segments.front();
+
+    if (pattern.segments.size() == 1)
+    {
+        return name.size() == head.size() && matches_segment(head, name);
+    }
+
+    const std::string_view tail = pattern.segments.back();
+
+    if (  name.size() < head.size() + tail.size()
+       || !matches_segment(head, name.substr(0, head.size()))
+       || !matches_segment(tail, name.substr(name.size() - tail.size())))
+    {
+        return false;
+    }
+
+    std::string_view middle = name.substr(head.size(),
+        name.size() - head.size() - tail.size());
+
+    for (std::size_t index = 1; index + 1 < pattern.segments.size(); ++index)
+    {
+        const std::string_view segment = pattern.segments[index];
+        std::size_t position = 0;
+
+        while (  position + segment.size() <= middle.size()
+              && !matches_segment(segment, middle.substr(position, segment.size())))
+        {
+            ++position;
+        }
+
+        if (position + segment.size() > middle.size())
+        {
+            return false;
+        }
+
+        middle.remove_prefix(position + segment.size());
+    }
+
+    return true;
+}
+
+ExcludeTrie::ExcludeTrie(const std::vector<std::string>& exclude_dirs) : nodes_(1)
+{
+    for (const auto& exclude_dir_str : exclude_dirs)
+    {
+        const boost::filesystem::path exclude_dir(exclude_dir_str);
+        boost::system::error_code error;
+
+        if (exclude_dir.empty())
+        {
+            continue;
+        }
+
+        insert(exclude_dir.lexically_normal());
+
+        const boost::filesystem::path canonical_dir =
+            boost::filesystem::canonical(exclude_dir, error);
+
+        if (!error)
+        {
+            insert(canonical_dir);
+        }
+    }
+}
+
+void ExcludeTrie::insert(const boost::filesystem::path& path)
+{
+    std::size_t node = 0;
+
+    for (const auto& component : path)
+    {
+        const std::string name = component.string();
+
+        if (name.empty() || name == ".")
+        {
+            continue;
+        }
+
+        const auto iterator = nodes_[node].children.find(name);
+
+        if (iterator != nodes_[node].children.cend())
+        {
+            node = iterator->second;
+            continue;
+        }
+
+        const std::size_t child = nodes_.size();
+
+        nodes_[node].children.emplace(name, child);
+        nodes_.emplace_back();
+        node = child;
+    }
+
+    nodes_[node].excluded = node != 0;
+}
+
+std::size_t ExcludeTrie::find(const boost::filesystem::path& path) const
+{
+    std::size_t node = 0;
+
+    for (const auto& component : path)
+    {
+        const std::string name = component.string();
+
+        if (name.empty() || name == ".")
+        {
+            continue;
+        }
+
+        node = descend(node, name);
+        if (node == NO_NODE || nodes_[node].excluded)
+        {
+            break;
+        }
+    }
+
+    return node;
+}
+
+std::size_t ExcludeTrie::descend(
+    const std::size_t node,
+    std::string_view  component) const
+{
+    if (node == NO_NODE || nodes_[node].excluded)
+    {
+        return node;
+    }
+
+    const auto iterator = nodes_[node].children.find(component);
+
+    return iterator == nodes_[node].children.cend() ? NO_NODE : iterator->second;
+}
+
+bool ExcludeTrie::is_excluded(const std::size_t node) const
+{
+    return node != NO_NODE && nodes_[node].excluded;
+}
+
+bool is_inside_directory(
+    std::string_view path,
+    std::string_view dir)
+{
+#if defined(_WIN32)
+    constexpr std::string_view SEPARATORS = "/\\";
+#else
+    constexpr std::string_view SEPARATORS = "/";
+#endif
+
+    return path.size() > dir.size()
+        && path.starts_with(dir)
+        && SEPARATORS.find(path[dir.size()]) != std::string_view::npos;
+}
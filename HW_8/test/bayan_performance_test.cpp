@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <bayan.hpp>
+#include <wrapper_boost_filesystem.hpp>
+
+namespace
+{
+    struct CorpusSpec
+    {
+        std::string name;
+        std::size_t file_count;
+        std::size_t files_per_directory;
+        std::uint64_t min_size;
+        std::uint64_t max_size;
+        double duplicate_ratio;
+        double hard_link_ratio;
+        double late_differing_ratio;
+        std::uint64_t seed;
+    };
+
+    struct CorpusStats
+    {
+        std::size_t files{0};
+        std::size_t duplicates{0};
+        std::size_t hard_links{0};
+        std::size_t late_differing{0};
+        std::uint64_t bytes{0};
+    };
+
+    struct SourceFile
+    {
+        boost::filesystem::path path;
+        std::uint64_t size;
+        std::uint64_t content_seed;
+    };
+
+    struct BenchmarkResult
+    {
+        double seconds{0};
+        std::uint64_t bytes_read{0};
+        std::uint64_t read_calls{0};
+        std::uint64_t write_calls{0};
+        long peak_rss_kib{0};
+        int exit_code{0};
+    };
+
+    void write_content(
+        const boost::filesystem::path& path,
+        const std::uint64_t            size,
+        const std::uint64_t            content_seed,
+        const bool                     flip_last_byte)
+    {
+        constexpr std::size_t CHUNK_SIZE = 65536;
+        std::mt19937_64 generator(content_seed);
+        std::vector<char> chunk(CHUNK_SIZE);
+        std::ofstream output(path.string(), std::ios::binary);
+
+        for (std::uint64_t written = 0; written < size;)
+        {
+            const auto length = static_cast<std::size_t>(
+                std::min<std::uint64_t>(CHUNK_SIZE, size - written));
+
+            for (auto& byte : chunk)
+            {
+                byte = static_cast<char>(generator());
+            }
+
+            written += length;
+            if (flip_last_byte && written == size)
+            {
+                chunk[length - 1] = static_cast<char>(~chunk[length - 1]);
+            }
+
+            output.write(chunk.data(), static_cast<std::streamsize>(length));
+        }
+    }
+
+    // Builds the same tree for the same spec: sizes are log-uniform between the
+    // bounds, and every new file is either unique content, an exact copy, a hard
+    // link or a copy whose last byte differs from an earlier file.
+    CorpusStats generate_corpus(
+        const CorpusSpec&              spec,
+        const boost::filesystem::path& root)
+    {
+        std::mt19937_64 generator(spec.seed);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::uniform_real_distribution<double> log_size(
+            std::log(static_cast<double>(spec.min_size)),
+            std::log(static_cast<double>(spec.max_size)));
+        std::vector<SourceFile> sources;
+        CorpusStats stats;
+
+        boost::filesystem::remove_all(root);
+        for (std::size_t index = 0; index < spec.file_count; ++index)
+        {
+            const boost::filesystem::path dir = root
+                / ("dir_" + std::to_string(index / spec.files_per_directory));
+            const boost::filesystem::path path =
+                dir / ("file_" + std::to_string(index) + ".dat");
+            const double kind = unit(generator);
+
+            if (index % spec.files_per_directory == 0)
+            {
+                boost::filesystem::create_directories(dir);
+            }
+
+            if (!sources.empty() && kind < spec.hard_link_ratio)
+            {
+                const auto& source = sources[generator() % sources.size()];
+
+                boost::filesystem::create_hard_link(source.path, path);
+                ++stats.hard_links;
+            }
+            else if (  !sources.empty()
+                    && kind < spec.hard_link_ratio + spec.duplicate_ratio)
+            {
+                const auto& source = sources[generator() % sources.size()];
+
+                write_content(path, source.size, source.content_seed, false);
+                stats.bytes += source.size;
+                ++stats.duplicates;
+            }
+            else if (  !sources.empty()
+                    && kind < spec.hard_link_ratio + spec.duplicate_ratio
+                        + spec.late_differing_ratio)
+            {
+                const auto& source = sources[generator() % sources.size()];
+
+                write_content(path, source.size, source.content_seed, true);
+                stats.bytes += source.size;
+                ++stats.late_differing;
+            }
+            else
+            {
+                const auto size =
+                    static_cast<std::uint64_t>(std::exp(log_size(generator)));
+                const std::uint64_t content_seed = generator();
+
+                write_content(path, size, content_seed, false);
+                sources.push_back({path, size, content_seed});
+                stats.bytes += size;
+            }
+
+            ++stats.files;
+        }
+
+        return stats;
+    }
+
+    std::uint64_t find_counter(
+        std::string_view text,
+        std::string_view label)
+    {
+        std::uint64_t value = 0;
+        const auto position = text.find(label);
+
+        if (position != std::string_view::npos)
+        {
+            const std::string_view digits = text.substr(position + label.size());
+
+            std::from_chars(digits.data(), digits.data() + digits.size(), value);
+        }
+
+        return value;
+    }
+
+#if defined(__linux__)
+    std::string read_descriptor(const int descriptor)
+    {
+        constexpr std::size_t BUFFER_SIZE = 4096;
+        std::array<char, BUFFER_SIZE> buffer {};
+        std::string result;
+
+        while (true)
+        {
+            const ssize_t bytes_read = ::read(descriptor, buffer.data(), buffer.size());
+
+            if (bytes_read <= 0)
+            {
+                break;
+            }
+
+            result.append(buffer.data(), static_cast<std::size_t>(bytes_read));
+        }
+
+        return result;
+    }
+
+    // Runs bayan in a child process so every configuration gets its own peak RSS
+    // and I/O counters.
+    BenchmarkResult run_benchmark(const std::vector<std::string>& arguments)
+    {
+        std::array<int, 2> output {};
+        BenchmarkResult result;
+
+        std::cout << std::flush;
+        if (::pipe(output.data()) == -1)
+        {
+            result.exit_code = -1;
+
+            return result;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const pid_t child = ::fork();
+
+        if (child == 0)
+        {
+            const int null_descriptor = ::open("/dev/null", O_WRONLY);
+            std::vector<const char*> argv {"bayan_performance_test"};
+
+            ::dup2(null_descriptor, STDOUT_FILENO);
+            ::dup2(output[1], STDERR_FILENO);
+            ::close(output[0]);
+            for (const auto& argument : arguments)
+            {
+                argv.emplace_back(argument.c_str());
+            }
+
+            auto [status, options] = option_process(argv);
+
+            if (status == ProcessStatus::SUCCESS)
+            {
+                status = process_files(options);
+            }
+
+            std::cerr << std::ifstream("/proc/self/io").rdbuf() << std::flush;
+            std::cout << std::flush;
+            ::_exit(static_cast<int>(status));
+        }
+
+        ::close(output[1]);
+
+        const std::string errors = read_descriptor(output[0]);
+        int status = 0;
+        rusage usage {};
+
+        ::close(output[0]);
+        ::wait4(child, &status, 0, &usage);
+        result.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        result.bytes_read = find_counter(errors, "Bytes read: ");
+        result.read_calls = find_counter(errors, "syscr: ");
+        result.write_calls = find_counter(errors, "syscw: ");
+        result.peak_rss_kib = usage.ru_maxrss;
+
+        return result;
+    }
+
+    // Drops the corpus from the page cache, so the next run reads from the
+    // device and the read backends can be compared.
+    void evict_from_page_cache(const boost::filesystem::path& root)
+    {
+        for (const auto& entry : boost::filesystem::recursive_directory_iterator(root))
+        {
+            if (!boost::filesystem::is_regular_file(entry.status()))
+            {
+                continue;
+            }
+
+            const int descriptor = ::open(entry.path().c_str(), O_RDONLY | O_CLOEXEC);
+
+            if (descriptor != -1)
+            {
+                ::fdatasync(descriptor);
+                ::posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+                ::close(descriptor);
+            }
+        }
+    }
+
+    void print_header()
+    {
+        constexpr int NAME_WIDTH = 10;
+        constexpr int VALUE_WIDTH = 14;
+
+        std::cout << std::left << std::setw(NAME_WIDTH) << "algorithm"
+            << std::setw(NAME_WIDTH) << "block" << std::setw(NAME_WIDTH) << "threads"
+            << std::setw(NAME_WIDTH) << "backend"
+            << std::right << std::setw(VALUE_WIDTH) << "time, s"
+            << std::setw(VALUE_WIDTH) << "files/s" << std::setw(VALUE_WIDTH)
+            << "bytes read" << std::setw(VALUE_WIDTH) << "read calls"
+            << std::setw(VALUE_WIDTH) << "write calls" << std::setw(VALUE_WIDTH)
+            << "peak RSS, KiB" << '\n';
+    }
+
+    void print_result(
+        std::string_view       algorithm,
+        const std::uint64_t    block_size,
+        const std::size_t      threads,
+        std::string_view       backend,
+        const std::size_t      files,
+        const BenchmarkResult& result)
+    {
+        constexpr int NAME_WIDTH = 10;
+        constexpr int VALUE_WIDTH = 14;
+        constexpr int PRECISION = 3;
+
+        std::cout << std::left << std::setw(NAME_WIDTH) << algorithm
+            << std::setw(NAME_WIDTH) << block_size << std::setw(NAME_WIDTH) << threads
+            << std::setw(NAME_WIDTH) << backend
+            << std::right << std::fixed << std::setprecision(PRECISION)
+            << std::setw(VALUE_WIDTH) << result.seconds << std::setprecision(0)
+            << std::setw(VALUE_WIDTH) << static_cast<double>(files) / result.seconds
+            << std::setw(VALUE_WIDTH) << result.bytes_read << std::setw(VALUE_WIDTH)
+            << result.read_calls << std::setw(VALUE_WIDTH) << result.write_calls
+            << std::setw(VALUE_WIDTH) << result.peak_rss_kib;
+        if (result.exit_code != 0)
+        {
+            std::cout << "  (exit code " << result.exit_code << ')';
+        }
+
+        std::cout << '\n';
+    }
+
+    void benchmark_corpus(
+        const CorpusSpec&              spec,
+        const boost::filesystem::path& work_dir,
+        const bool                     cold_cache)
+    {
+        constexpr std::array ALGORITHMS {"crc32", "md5"};
+        constexpr std::array BACKENDS {"io_uring", "threads"};
+        constexpr std::array<std::uint64_t, 3> BLOCK_SIZES {4096, 65536, 1048576};
+        const std::array<std::size_t, 2> THREAD_COUNTS
+            {1, std::max(2U, std::thread::hardware_concurrency())};
+        const boost::filesystem::path root = work_dir / spec.name;
+        const CorpusStats stats = generate_corpus(spec, root);
+
+        std::cout << "=== Performance Test: " << spec.name
+            << (cold_cache ? " (cold page cache)" : "") << " ===\n";
+        std::cout << "Files: " << stats.files << ", bytes: " << stats.bytes
+            << ", duplicates: " << stats.duplicates << ", hard links: "
+            << stats.hard_links << ", late-differing: " << stats.late_differing
+            << '\n';
+        print_header();
+
+        for (const auto *algorithm : ALGORITHMS)
+        {
+            for (const auto block_size : BLOCK_SIZES)
+            {
+                for (const auto threads : THREAD_COUNTS)
+                {
+                    for (const auto *backend : BACKENDS)
+                    {
+                        if (cold_cache)
+                        {
+                            evict_from_page_cache(root);
+                        }
+
+                        const auto result = run_benchmark({
+                            "--scan_dirs", root.string(),
+                            "--scan_level", "1",
+                            "--block_size", std::to_string(block_size),
+                            "--hash_algorithm", algorithm,
+                            "--threads", std::to_string(threads),
+                            "--io_backend", backend,
+                            "--stats"});
+
+                        print_result(algorithm, block_size, threads, backend,
+                            stats.files, result);
+                    }
+                }
+            }
+        }
+
+        std::cout << '\n';
+        boost::filesystem::remove_all(root);
+    }
+#endif
+} // namespace
+
+int main(int argc, char* argv[])
+{
+#if defined(__linux__)
+    constexpr std::uint64_t KIB = 1024;
+    constexpr std::uint64_t MIB = 1024 * KIB;
+    const std::vector<CorpusSpec> corpora
+    {
+        {"many small files", 20000, 500, 512, 16 * KIB, 0.3, 0.05, 0.1, 1},
+        {"few large files", 120, 20, 256 * KIB, 4 * MIB, 0.3, 0.05, 0.2, 2},
+        {"unique content", 50000, 1000, 1, 64 * KIB, 0.0, 0.0, 0.0, 3}
+    };
+    const std::span<char*> arguments(argv, static_cast<std::size_t>(argc));
+    boost::filesystem::path work_dir =
+        boost::filesystem::temp_directory_path() / "bayan_performance_test";
+    bool cold_cache = false;
+
+    for (const std::string_view argument : arguments.subspan(1))
+    {
+        if (argument == "--cold")
+        {
+            cold_cache = true;
+        }
+        else
+        {
+            work_dir = std::string(argument);
+        }
+    }
+
+    for (const auto& corpus : corpora)
+    {
+        benchmark_corpus(corpus, work_dir, cold_cache);
+    }
+
+    boost::filesystem::remove_all(work_dir);
+#else
+    static_cast<void>(argc);
+    static_cast<void>(argv);
+    std::cout << "The bayan performance test is supported only on Linux\n";
+#endif
+
+    return 0;
+}
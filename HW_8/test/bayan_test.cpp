@@ -1,12 +1,19 @@
 #if defined(_MSC_VER) && !defined(__clang__) && !defined(__INTEL_COMPILER)
 #include <array>
 #endif
+#include <random>
 
 #include <gtest/gtest.h>
 
 #include <absl_strings_match.hpp>
 #include <bayan.hpp>
+#include <block_pipeline.hpp>
 #include <capture.hpp>
+#include <chunk_index.hpp>
+#include <duplicate_index.hpp>
+#include <file_table.hpp>
+#include <hash_cache.hpp>
+#include <path_filter.hpp>
 #include <wrapper_boost_filesystem.hpp>
 
 TEST(HW8, NoDuplicatesTest)
@@ -235,3 +242,858 @@ TEST(HW8, BadHashAlgorithmTest)
     ASSERT_EQ(status, ProcessStatus::OPTION_ERROR);
     ASSERT_TRUE(absl::StrContains(capturedStderr, "is invalid"));
 }
+
+TEST(HW8, HashCacheRoundTripTest)
+{
+    const boost::filesystem::path cache_file =
+        boost::filesystem::current_path() / "bayan_test_cache.bin";
+    const FileKey key{.device = 1, .inode = 2, .size = 10, .mtime_ns = 3};
+    const std::vector<std::string> hashes = {"A", "", "C"};
+
+    boost::filesystem::remove(cache_file);
+
+    {
+        HashCache cache(cache_file.string(), 5, hash_algorithm::md5);
+
+        ASSERT_TRUE(cache.load());
+        ASSERT_EQ(cache.size(), 0);
+        cache.store(key, hashes);
+        ASSERT_TRUE(cache.save());
+    }
+
+    HashCache cache(cache_file.string(), 5, hash_algorithm::md5);
+    ASSERT_TRUE(cache.load());
+    ASSERT_EQ(cache.size(), 1);
+
+    const auto *cached_hashes = cache.find(key);
+    ASSERT_NE(cached_hashes, nullptr);
+    ASSERT_EQ(*cached_hashes, hashes);
+
+    FileKey modified_key = key;
+    modified_key.mtime_ns++;
+    ASSERT_EQ(cache.find(modified_key), nullptr);
+
+    HashCache other_block_size(cache_file.string(), 6, hash_algorithm::md5);
+    ASSERT_TRUE(other_block_size.load());
+    ASSERT_EQ(other_block_size.find(key), nullptr);
+
+    {
+        std::ofstream corrupted(cache_file.string(), std::ios::binary | std::ios::trunc);
+        corrupted << "BAYANHC1garbage";
+    }
+
+    HashCache corrupted_cache(cache_file.string(), 5, hash_algorithm::md5);
+    ASSERT_FALSE(corrupted_cache.load());
+    ASSERT_EQ(corrupted_cache.size(), 0);
+
+    boost::filesystem::remove(cache_file);
+}
+
+TEST(HW8, HashCachePruneTest)
+{
+    const boost::filesystem::path cache_file =
+        boost::filesystem::current_path() / "bayan_test_cache_prune.bin";
+    const FileKey kept{.device = 1, .inode = 2, .size = 10, .mtime_ns = 3};
+    const FileKey dropped{.device = 1, .inode = 4, .size = 10, .mtime_ns = 3};
+    const FileKey oversized{.device = 1, .inode = 5, .size = 10, .mtime_ns = 3};
+    const std::vector<std::string> hashes = {"A", "B"};
+
+    boost::filesystem::remove(cache_file);
+
+    {
+        HashCache cache(cache_file.string(), 5, hash_algorithm::md5);
+
+        ASSERT_TRUE(cache.load());
+        cache.store(kept, hashes);
+        cache.store(dropped, hashes);
+        cache.store(oversized, {std::string(256, 'X')});
+        ASSERT_EQ(cache.size(), 2);
+        ASSERT_EQ(cache.find(oversized), nullptr);
+        ASSERT_TRUE(cache.save());
+    }
+
+    {
+        HashCache cache(cache_file.string(), 5, hash_algorithm::md5);
+
+        ASSERT_TRUE(cache.load());
+        ASSERT_EQ(cache.size(), 2);
+        ASSERT_NE(cache.find(kept), nullptr);
+        ASSERT_TRUE(cache.save());
+    }
+
+    HashCache cache(cache_file.string(), 5, hash_algorithm::md5);
+    ASSERT_TRUE(cache.load());
+    ASSERT_EQ(cache.size(), 1);
+    ASSERT_EQ(cache.find(dropped), nullptr);
+
+    const auto *cached_hashes = cache.find(kept);
+    ASSERT_NE(cached_hashes, nullptr);
+    ASSERT_EQ(*cached_hashes, hashes);
+
+    boost::filesystem::remove(cache_file);
+}
+
+TEST(HW8, CacheOptionTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_cache_dir";
+    const boost::filesystem::path cache_file =
+        boost::filesystem::current_path() / "bayan_test_cache_option.bin";
+    const boost::filesystem::path first_file = temp_dir / "first.txt";
+    const boost::filesystem::path second_file = temp_dir / "second.txt";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::string& cache_file_str = cache_file.string();
+    const std::array argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "4",
+        "--scan_level", "0",
+        "--cache", cache_file_str.c_str()
+    };
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::remove(cache_file);
+    boost::filesystem::create_directory(temp_dir);
+
+    {
+        std::ofstream first_stream(first_file.string());
+        first_stream << "Hello, World\n";
+
+        std::ofstream second_stream(second_file.string());
+        second_stream << "Hello, World\n";
+    }
+
+    auto [status, options] = option_process(argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_EQ(options.cache_path, cache_file_str);
+
+    for (int run = 0; run < 2; ++run)
+    {
+        StdoutCapture::Begin();
+        const auto result = process_files(options);
+        const auto capturedStdout = StdoutCapture::End();
+
+        ASSERT_EQ(result, ProcessStatus::SUCCESS);
+        ASSERT_TRUE(absl::StrContains(capturedStdout, first_file.string()));
+        ASSERT_TRUE(absl::StrContains(capturedStdout, second_file.string()));
+        ASSERT_TRUE(boost::filesystem::exists(cache_file));
+    }
+
+    HashCache cache(cache_file_str, 4, hash_algorithm::crc32);
+    ASSERT_TRUE(cache.load());
+    ASSERT_EQ(cache.size(), 2);
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::remove(cache_file);
+}
+
+TEST(HW8, ParallelScanTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_parallel";
+    const boost::filesystem::path excluded_dir = temp_dir / "excluded";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::string& excluded_dir_str = excluded_dir.string();
+    const std::array argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--exclude_dirs", excluded_dir_str.c_str(),
+        "--block_size", "8",
+        "--scan_level", "1",
+        "--threads", "4"
+    };
+    std::vector<boost::filesystem::path> expected_files;
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(excluded_dir);
+
+    for (int level = 0; level < 4; ++level)
+    {
+        boost::filesystem::path dir = temp_dir;
+
+        for (int depth = 0; depth <= level; ++depth)
+        {
+            dir /= "dir" + std::to_string(depth);
+        }
+
+        boost::filesystem::create_directories(dir);
+        expected_files.emplace_back(dir / "same.txt");
+        std::ofstream(expected_files.back().string()) << "parallel scan\n";
+    }
+
+    std::ofstream((excluded_dir / "same.txt").string()) << "parallel scan\n";
+    boost::filesystem::create_directory_symlink("..", temp_dir / "dir0" / "loop");
+
+    auto [status, options] = option_process(argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_EQ(options.threads, 4);
+
+    StdoutCapture::Begin();
+    const auto result = process_files(options);
+    const auto capturedStdout = StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    for (const auto& file : expected_files)
+    {
+        ASSERT_TRUE(absl::StrContains(capturedStdout, file.string() + '\n'));
+    }
+
+    ASSERT_FALSE(absl::StrContains(capturedStdout, excluded_dir.string()));
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, HardLinkTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_hardlinks";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::array argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "4",
+        "--scan_level", "0"
+    };
+    const std::array report_argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "4",
+        "--scan_level", "0",
+        "--report_hardlinks"
+    };
+    const std::string original = (temp_dir / "a_original.txt").string();
+    const std::string link = (temp_dir / "b_link.txt").string();
+    const std::string copy = (temp_dir / "c_copy.txt").string();
+    const std::string lonely = (temp_dir / "d_lonely.txt").string();
+    const std::string lonely_link = (temp_dir / "e_lonely_link.txt").string();
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(temp_dir);
+    std::ofstream(original) << "same content\n";
+    std::ofstream(copy) << "same content\n";
+    std::ofstream(lonely) << "other content\n";
+    boost::filesystem::create_hard_link(original, link);
+    boost::filesystem::create_hard_link(lonely, lonely_link);
+
+    auto [status, options] = option_process(argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_FALSE(options.report_hardlinks);
+
+    StdoutCapture::Begin();
+    auto result = process_files(options);
+    auto capturedStdout = StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(absl::StrContains(capturedStdout,
+        original + '\n' + link + '\n' + copy + '\n'));
+    ASSERT_TRUE(absl::StrContains(capturedStdout, lonely + '\n' + lonely_link + '\n'));
+    ASSERT_FALSE(absl::StrContains(capturedStdout, "Hard links:"));
+
+    std::tie(status, options) = option_process(report_argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(options.report_hardlinks);
+
+    StdoutCapture::Begin();
+    result = process_files(options);
+    capturedStdout = StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_EQ(capturedStdout, original + '\n' + copy + "\n\n"
+        "Hard links:\n"
+        + original + '\n' + link + "\n\n"
+        + lonely + '\n' + lonely_link + "\n\n");
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, SymlinkIsNoHardLinkTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_symlinks";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::array argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "4",
+        "--scan_level", "0",
+        "--report_hardlinks"
+    };
+    const std::string original = (temp_dir / "a_original.txt").string();
+    const std::string link = (temp_dir / "b_link.txt").string();
+    const std::string symlink = (temp_dir / "c_symlink.txt").string();
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(temp_dir);
+    std::ofstream(original) << "same content\n";
+    boost::filesystem::create_hard_link(original, link);
+    boost::filesystem::create_symlink("a_original.txt", symlink);
+
+    auto [status, options] = option_process(argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+
+    StdoutCapture::Begin();
+    const auto result = process_files(options);
+    const auto capturedStdout = StdoutCapture::End();
+
+    // The symlink is compared by content like any other path, but never
+    // listed as a hard link of its target.
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_EQ(capturedStdout, original + '\n' + symlink + "\n\n"
+        "Hard links:\n"
+        + original + '\n' + link + "\n\n");
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, SampledBlocksTest)
+{
+    constexpr std::size_t FILE_SIZE = 65536;
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_sampling";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::array argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "4096",
+        "--scan_level", "0",
+        "--stats"
+    };
+    std::string content(FILE_SIZE, 'x');
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(temp_dir);
+    std::ofstream((temp_dir / "first.bin").string(), std::ios::binary) << content;
+    content.back() = 'y';
+    std::ofstream((temp_dir / "second.bin").string(), std::ios::binary) << content;
+
+    auto [status, options] = option_process(argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(options.stats);
+
+    StdoutCapture::Begin();
+    StderrCapture::Begin();
+    const auto result = process_files(options);
+    const auto capturedStderr = StderrCapture::End();
+    const auto capturedStdout = StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_EQ(capturedStdout, "No duplicate files found.\n");
+    ASSERT_TRUE(absl::StrContains(capturedStderr, "Files scanned: 2\n"));
+    ASSERT_TRUE(absl::StrContains(capturedStderr, "Bytes read: 16384 of 131072\n"));
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, GlobMatcherTest)
+{
+    const GlobMatcher any_file({});
+    const GlobMatcher matcher({"*.TXT", "data_??.bin", "a*b*c"});
+
+    ASSERT_TRUE(any_file.matches("anything"));
+    ASSERT_TRUE(matcher.matches("notes.txt"));
+    ASSERT_TRUE(matcher.matches("Notes.Txt"));
+    ASSERT_TRUE(matcher.matches(".txt"));
+    ASSERT_FALSE(matcher.matches("notes.txt.bak"));
+    ASSERT_FALSE(matcher.matches("notes_txt"));
+    ASSERT_TRUE(matcher.matches("DATA_01.bin"));
+    ASSERT_FALSE(matcher.matches("data_1.bin"));
+    ASSERT_TRUE(matcher.matches("abc"));
+    ASSERT_TRUE(matcher.matches("a-b-b-c"));
+    ASSERT_FALSE(matcher.matches("acb"));
+    ASSERT_FALSE(matcher.matches("abcd"));
+}
+
+TEST(HW8, ExcludeTrieTest)
+{
+    const ExcludeTrie trie({"/data/skip", "relative/dir/"});
+
+    ASSERT_TRUE(trie.is_excluded(trie.find("/data/skip")));
+    ASSERT_TRUE(trie.is_excluded(trie.find("/data/skip/nested")));
+    ASSERT_FALSE(trie.is_excluded(trie.find("/data/skipped")));
+    ASSERT_FALSE(trie.is_excluded(trie.find("/data")));
+    ASSERT_TRUE(trie.is_excluded(trie.find("relative/dir")));
+    ASSERT_TRUE(trie.is_excluded(trie.find("./relative/dir")));
+
+    const std::size_t data = trie.find("/data");
+
+    ASSERT_TRUE(trie.is_excluded(trie.descend(data, "skip")));
+    ASSERT_FALSE(trie.is_excluded(trie.descend(data, "other")));
+    ASSERT_EQ(trie.descend(trie.descend(data, "other"), "skip"), ExcludeTrie::NO_NODE);
+}
+
+TEST(HW8, FileTableTest)
+{
+    FileTable table;
+    const auto root = table.add_directory(FileTable::NO_INDEX, "/data");
+    const auto nested = table.add_directory(root, "b");
+    const auto nested_file = table.add_file(nested, "z.txt", 3);
+    const auto sibling_file = table.add_file(root, "b.txt", 3);
+    const auto last_file = table.add_file(root, "c", 5);
+    const auto link = table.add_file(root, "a", 3);
+
+    ASSERT_EQ(table.size(), 4);
+    ASSERT_EQ(table.path(nested_file), boost::filesystem::path("/data/b/z.txt"));
+    ASSERT_EQ(table.directory_path(nested), boost::filesystem::path("/data/b"));
+    ASSERT_EQ(table.sorted_files(),
+        (std::vector<FileTable::Index>{link, sibling_file, nested_file, last_file}));
+
+    table.add_link(sibling_file, link);
+    ASSERT_TRUE(table.is_link(link));
+    ASSERT_EQ(table.next_link(sibling_file), link);
+    ASSERT_EQ(table.next_link(link), FileTable::NO_INDEX);
+    table.unlink(sibling_file);
+    ASSERT_FALSE(table.is_link(link));
+    ASSERT_EQ(table.next_link(sibling_file), FileTable::NO_INDEX);
+
+    ASSERT_TRUE(table.find_digests(last_file).empty());
+    table.digests(last_file, 2)[1] = "digest";
+    ASSERT_EQ(table.find_digests(last_file).size(), 2);
+    ASSERT_EQ(table.find_digests(last_file)[1], "digest");
+
+    table.remove(last_file);
+    ASSERT_TRUE(table.is_removed(last_file));
+    ASSERT_TRUE(table.find_digests(last_file).empty());
+    ASSERT_EQ(table.sorted_files(),
+        (std::vector<FileTable::Index>{link, sibling_file, nested_file}));
+}
+
+TEST(HW8, DuplicateIndexTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_index";
+    const boost::filesystem::path nested_dir = temp_dir / "nested";
+    const boost::filesystem::path first = temp_dir / "first.txt";
+    const boost::filesystem::path second = temp_dir / "second.txt";
+    const boost::filesystem::path third = nested_dir / "third.txt";
+    DuplicateIndex index(HashAlgorithm(hash_algorithm::md5), 4);
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(nested_dir);
+    std::ofstream(first.string()) << "same content\n";
+    std::ofstream(second.string()) << "same content\n";
+    std::ofstream(third.string()) << "same content\n";
+
+    ASSERT_TRUE(index.add(first, 13).empty());
+
+    auto changes = index.add(second, 13);
+    ASSERT_EQ(changes.size(), 1);
+    ASSERT_TRUE(changes[0].formed);
+    ASSERT_EQ(changes[0].paths,
+        (std::vector<std::string>{first.string(), second.string()}));
+
+    std::ofstream(second.string()) << "other content\n";
+    changes = index.add(second, 14);
+    ASSERT_EQ(changes.size(), 1);
+    ASSERT_FALSE(changes[0].formed);
+
+    changes = index.add(third, 13);
+    ASSERT_EQ(changes.size(), 1);
+    ASSERT_TRUE(changes[0].formed);
+    ASSERT_EQ(changes[0].paths,
+        (std::vector<std::string>{first.string(), third.string()}));
+    ASSERT_EQ(index.size(), 3);
+
+    changes = index.remove_directory(nested_dir);
+    ASSERT_EQ(changes.size(), 1);
+    ASSERT_FALSE(changes[0].formed);
+    ASSERT_EQ(index.size(), 2);
+
+    ASSERT_TRUE(index.remove(second).empty());
+    ASSERT_TRUE(index.remove(second).empty());
+    ASSERT_EQ(index.size(), 1);
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, StructuredOutputTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_output";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::array ndjson_argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "4",
+        "--scan_level", "0",
+        "--hash_algorithm", "md5",
+        "--output_format", "ndjson"
+    };
+    const std::array print0_argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "4",
+        "--scan_level", "0",
+        "--print0"
+    };
+    const std::string first = (temp_dir / "first.txt").string();
+    const std::string second = (temp_dir / "second \"quoted\".txt").string();
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(temp_dir);
+    std::ofstream(first) << "same content\n";
+    std::ofstream(second) << "same content\n";
+
+    auto [status, options] = option_process(ndjson_argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_EQ(options.format, output_format::ndjson);
+
+    StdoutCapture::Begin();
+    auto result = process_files(options);
+    auto capturedStdout = StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_EQ(capturedStdout, R"({"type":"duplicates","size":13,"digest":")"
+        + compute_md5(compute_md5("same") + compute_md5(" con") + compute_md5("tent")
+            + compute_md5("\n"))
+        + R"(","paths":[")" + first + R"(",")" + temp_dir_str
+        + R"(/second \"quoted\".txt"]})" + '\n');
+
+    std::tie(status, options) = option_process(print0_argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(options.print0);
+
+    StdoutCapture::Begin();
+    result = process_files(options);
+    capturedStdout = StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_EQ(capturedStdout, first + '\0' + second + '\0' + '\0');
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, VerifyTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_verify";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::array argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "8",
+        "--scan_level", "0"
+    };
+    const std::array verify_argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "8",
+        "--scan_level", "0",
+        "--verify",
+        "--stats"
+    };
+    const std::string first = (temp_dir / "a_first.txt").string();
+    const std::string collision = (temp_dir / "b_collision.txt").string();
+    const std::string copy = (temp_dir / "c_copy.txt").string();
+
+    // Both contents have the same CRC-32, so without --verify they look equal.
+    ASSERT_EQ(compute_crc32("iTjH0lNb"), compute_crc32("mbyj3bEy"));
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(temp_dir);
+    std::ofstream(first) << "iTjH0lNb";
+    std::ofstream(collision) << "mbyj3bEy";
+    std::ofstream(copy) << "iTjH0lNb";
+
+    auto [status, options] = option_process(argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_FALSE(options.verify);
+
+    StdoutCapture::Begin();
+    auto result = process_files(options);
+    auto capturedStdout = StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_EQ(capturedStdout, first + '\n' + collision + '\n' + copy + "\n\n");
+
+    std::tie(status, options) = option_process(verify_argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(options.verify);
+
+    StdoutCapture::Begin();
+    StderrCapture::Begin();
+    result = process_files(options);
+    const auto capturedStderr = StderrCapture::End();
+    capturedStdout = StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_EQ(capturedStdout, first + '\n' + copy + "\n\n");
+    ASSERT_TRUE(absl::StrContains(capturedStderr, "Bytes verified: 24\n"));
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, ActionTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_action";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::array dry_run_argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "8",
+        "--scan_level", "0",
+        "--action", "delete",
+        "--dry_run"
+    };
+    const std::array hardlink_argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "8",
+        "--scan_level", "0",
+        "--action", "hardlink",
+        "--keep", "shortest_path"
+    };
+    const boost::filesystem::path keep = temp_dir / "keep.txt";
+    const boost::filesystem::path copy_one = temp_dir / "copy_one.txt";
+    const boost::filesystem::path copy_two = temp_dir / "copy_two.txt";
+    const boost::filesystem::path unique = temp_dir / "unique.txt";
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(temp_dir);
+    std::ofstream(keep.string()) << "same content\n";
+    std::ofstream(copy_one.string()) << "same content\n";
+    std::ofstream(copy_two.string()) << "same content\n";
+    std::ofstream(unique.string()) << "other content\n";
+
+    auto [status, options] = option_process(dry_run_argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_EQ(options.action, dedup_action::remove);
+    ASSERT_TRUE(options.dry_run);
+
+    StdoutCapture::Begin();
+    StderrCapture::Begin();
+    auto result = process_files(options);
+    auto capturedStderr = StderrCapture::End();
+    StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(absl::StrContains(capturedStderr, "Bytes to reclaim: 26\n"));
+    ASSERT_TRUE(boost::filesystem::exists(copy_one));
+    ASSERT_TRUE(boost::filesystem::exists(copy_two));
+
+    std::tie(status, options) = option_process(hardlink_argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_EQ(options.keep, keep_policy::shortest_path);
+
+    StdoutCapture::Begin();
+    StderrCapture::Begin();
+    result = process_files(options);
+    capturedStderr = StderrCapture::End();
+    StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(absl::StrContains(capturedStderr, "Bytes reclaimed: 26\n"));
+    ASSERT_EQ(boost::filesystem::hard_link_count(keep), 3U);
+    ASSERT_EQ(boost::filesystem::hard_link_count(unique), 1U);
+    ASSERT_EQ(std::distance(boost::filesystem::directory_iterator(temp_dir),
+        boost::filesystem::directory_iterator()), 4);
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, ActionSkipsSymlinksTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_action_symlink";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::array argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "8",
+        "--scan_level", "0",
+        "--action", "hardlink",
+        "--keep", "shortest_path"
+    };
+    const boost::filesystem::path original = temp_dir / "original.txt";
+    const boost::filesystem::path copy = temp_dir / "copy_of_original.txt";
+    const boost::filesystem::path symlink = temp_dir / "s";
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(temp_dir);
+    std::ofstream(original.string()) << "same content\n";
+    std::ofstream(copy.string()) << "same content\n";
+    // The shortest path in the group, and relative to its own directory.
+    boost::filesystem::create_symlink("original.txt", symlink);
+
+    auto [status, options] = option_process(argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+
+    StdoutCapture::Begin();
+    StderrCapture::Begin();
+    const auto result = process_files(options);
+    const auto capturedStderr = StderrCapture::End();
+    StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(absl::StrContains(capturedStderr, "Bytes reclaimed: 13\n"));
+    ASSERT_TRUE(boost::filesystem::is_symlink(symlink));
+    ASSERT_EQ(boost::filesystem::read_symlink(symlink), "original.txt");
+    ASSERT_EQ(boost::filesystem::hard_link_count(original), 2U);
+    ASSERT_TRUE(boost::filesystem::equivalent(original, copy));
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, KeepFirstScanDirTest)
+{
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_keep_first";
+    // Sorts after the second directory, so only the scan order picks it.
+    const boost::filesystem::path first_dir = temp_dir / "z_first";
+    const boost::filesystem::path second_dir = temp_dir / "a_second";
+    const std::string first_dir_str = first_dir.string() + '/';
+    const std::string second_dir_str = (temp_dir / "." / "a_second").string();
+    const std::array argv =
+    {
+        "bayan_test",
+        "--scan_dirs", first_dir_str.c_str(),
+        "--scan_dirs", second_dir_str.c_str(),
+        "--block_size", "8",
+        "--scan_level", "0",
+        "--action", "delete"
+    };
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(first_dir);
+    boost::filesystem::create_directories(second_dir);
+    std::ofstream((first_dir / "file.txt").string()) << "same content\n";
+    std::ofstream((second_dir / "file.txt").string()) << "same content\n";
+
+    auto [status, options] = option_process(argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_EQ(options.keep, keep_policy::first_scan_dir);
+
+    StdoutCapture::Begin();
+    StderrCapture::Begin();
+    const auto result = process_files(options);
+    StderrCapture::End();
+    StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(boost::filesystem::exists(first_dir / "file.txt"));
+    ASSERT_FALSE(boost::filesystem::exists(second_dir / "file.txt"));
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, SimilarFilesTest)
+{
+    constexpr std::size_t CONTENT_SIZE = 200000;
+    constexpr std::size_t INSERT_POSITION = 70000;
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_similar";
+    const std::string& temp_dir_str = temp_dir.string();
+    const std::array argv =
+    {
+        "bayan_test",
+        "--scan_dirs", temp_dir_str.c_str(),
+        "--block_size", "4096",
+        "--scan_level", "0",
+        "--similar", "150000"
+    };
+    const std::string original = (temp_dir / "original.bin").string();
+    const std::string edited = (temp_dir / "edited.bin").string();
+    std::mt19937 generator(1);
+    std::string content(CONTENT_SIZE, '\0');
+
+    for (auto& byte : content)
+    {
+        byte = static_cast<char>(generator());
+    }
+
+    // One inserted byte only changes the chunks around it.
+    const std::size_t first_cut = ContentChunker::next_cut(content);
+    std::string shifted = content;
+
+    shifted.insert(0, 1, 'x');
+    ASSERT_EQ(ContentChunker::next_cut(std::string_view(shifted).substr(1)), first_cut);
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(temp_dir);
+    std::ofstream(original, std::ios::binary) << content;
+    content.insert(INSERT_POSITION, 1, 'x');
+    std::ofstream(edited, std::ios::binary) << content;
+    std::ofstream((temp_dir / "unrelated.bin").string(), std::ios::binary)
+        << std::string(CONTENT_SIZE, 'u');
+
+    auto [status, options] = option_process(argv);
+    ASSERT_EQ(status, ProcessStatus::SUCCESS);
+    ASSERT_EQ(options.similar_bytes, 150000U);
+
+    StdoutCapture::Begin();
+    const auto result = process_files(options);
+    const auto capturedStdout = StdoutCapture::End();
+
+    ASSERT_EQ(result, ProcessStatus::SUCCESS);
+    ASSERT_TRUE(absl::StrContains(capturedStdout,
+        "\n" + edited + '\n' + original + "\n\n"));
+    ASSERT_FALSE(absl::StrContains(capturedStdout, "unrelated.bin"));
+
+    boost::filesystem::remove_all(temp_dir);
+}
+
+TEST(HW8, BlockPipelineTest)
+{
+    constexpr std::size_t BLOCK_SIZE = 4096;
+    constexpr std::size_t CONTENT_SIZE = 10000;
+    const boost::filesystem::path temp_dir =
+        boost::filesystem::current_path() / "bayan_test_pipeline";
+    std::mt19937 generator(2);
+    std::string content(CONTENT_SIZE, '\0');
+    FileTable table;
+
+    for (auto& byte : content)
+    {
+        byte = static_cast<char>(generator());
+    }
+
+    boost::filesystem::remove_all(temp_dir);
+    boost::filesystem::create_directories(temp_dir);
+    std::ofstream((temp_dir / "first.bin").string(), std::ios::binary) << content;
+    std::ofstream((temp_dir / "second.bin").string(), std::ios::binary)
+        << content.substr(BLOCK_SIZE);
+
+    const auto dir = table.add_directory(FileTable::NO_INDEX, temp_dir.string());
+    const auto first = table.add_file(dir, "first.bin", CONTENT_SIZE);
+    const auto second = table.add_file(dir, "second.bin", CONTENT_SIZE - BLOCK_SIZE);
+
+    for (const auto backend : {io_backend::io_uring, io_backend::threads})
+    {
+        BlockPipeline pipeline(table, HashAlgorithm(hash_algorithm::md5), BLOCK_SIZE,
+            backend, {2});
+        std::array<std::string, 3> digests;
+        const std::array<BlockPipeline::Request, 3> requests
+        {{
+            {first, 0, &digests[0]},
+            {second, BLOCK_SIZE, &digests[1]},
+            {first, 2 * BLOCK_SIZE, &digests[2]}
+        }};
+
+        // The first file appears twice, so it needs two runs.
+        StderrCapture::Begin();
+        pipeline.run(std::span(requests).first(2));
+        pipeline.run(std::span(requests).subspan(2));
+        StderrCapture::End();
+
+        ASSERT_EQ(digests[0], compute_md5(content.substr(0, BLOCK_SIZE)));
+        ASSERT_EQ(digests[1], compute_md5(content.substr(2 * BLOCK_SIZE)));
+        ASSERT_EQ(digests[2], digests[1]);
+        ASSERT_EQ(pipeline.bytes_read(),
+            BLOCK_SIZE + 2 * (CONTENT_SIZE - 2 * BLOCK_SIZE));
+    }
+
+    boost::filesystem::remove_all(temp_dir);
+}
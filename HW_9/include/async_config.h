@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace async {
+
+enum class file_format {
+    // A bulk<time>_<context>_<writer>_<n>.log file for every block.
+    per_block,
+    // Blocks appended to bulk_segment_<writer>_<time>_<n>.log files, each one
+    // framed by a "#<time> <context> <length>" line.
+    segments
+};
+
+// What happens to a new block while the blocks waiting for the writers are
+// over high_watermark.
+enum class overflow_policy {
+    // receive() waits until the writers are back under low_watermark.
+    block,
+    // The block is discarded and counted in dropped_blocks().
+    drop,
+    // The block is kept in bulk_spill.tmp and queued again once the writers
+    // are back under low_watermark.
+    spill
+};
+
+// How the server library, where connections share static blocks, groups the
+// static commands of different connections.
+enum class static_mixing {
+    // Every connection feeds one aggregator, so a block mixes commands from
+    // any of them.
+    strict,
+    // A connection feeds one of static_shards aggregators picked by its id;
+    // a block only mixes commands of connections on the same shard.
+    relaxed
+};
+
+struct config {
+    // Threads writing bulk files, each draining a queue of its own.
+    std::size_t file_writers = 2;
+    file_format format = file_format::per_block;
+    // A segment is closed once it would grow past segment_bytes or has been
+    // open for segment_age.
+    std::size_t segment_bytes = std::size_t{64} * 1024 * 1024;
+    std::chrono::seconds segment_age{60};
+    // Calls fdatasync() once for every batch of blocks written together.
+    bool sync_segments = false;
+    // Emits a partly filled static block this long after its first command
+    // arrived; zero keeps it until the block is full or the handle closes.
+    std::chrono::milliseconds max_latency{0};
+    // Blocks that may wait for the writers before the overflow policy applies,
+    // and the count they have to fall back to before it is lifted; a zero
+    // high_watermark leaves the queues unbounded.
+    std::size_t high_watermark = 0;
+    std::size_t low_watermark = 0;
+    overflow_policy overflow = overflow_policy::block;
+    static_mixing mixing = static_mixing::strict;
+    std::size_t static_shards = 4;
+};
+
+// Takes effect when the output threads next start, that is on the first
+// connect while no other handle is connected.
+void configure(const config& settings);
+
+// Blocks built but not yet written by every writer.
+std::size_t queued_blocks();
+
+// True from the moment queued_blocks() goes past high_watermark until it falls
+// back to low_watermark. Producers able to hold off, such as a server that
+// can stop reading its sockets, should do so meanwhile.
+bool output_throttled();
+
+// Blocks discarded by the drop policy, or because they could not be spilled.
+std::uint64_t dropped_blocks();
+
+}
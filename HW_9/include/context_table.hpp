@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "async.h"
+
+namespace async {
+
+// Maps handles to contexts without a lock on lookup. A handle packs a slot
+// index with the generation of the slot, so a handle that was disconnected
+// stops matching even after its slot has been reused by a new connection.
+// Slots never move or get freed; connect and disconnect serialize on a mutex.
+template <typename Context>
+class context_table {
+    static constexpr std::size_t PAGE_SIZE = 256;
+    static constexpr std::size_t MAX_PAGES = 1024;
+    static constexpr unsigned INDEX_BITS = sizeof(std::uintptr_t) * CHAR_BIT / 2;
+    static constexpr std::uintptr_t INDEX_MASK = (std::uintptr_t{1} << INDEX_BITS) - 1;
+
+    struct slot {
+        // Odd while the slot holds a context.
+        std::atomic<std::uintptr_t> generation{0};
+        std::atomic<unsigned> readers{0};
+        std::unique_ptr<Context> context;
+    };
+
+    using page = std::array<slot, PAGE_SIZE>;
+
+    std::array<std::unique_ptr<page>, MAX_PAGES> pages_;
+    std::atomic<std::size_t> page_count_{0};
+    std::mutex mutex_;
+    std::vector<std::size_t> free_slots_;
+    std::size_t slot_count_ = 0;
+    std::size_t live_count_ = 0;
+
+    slot& slot_at(std::uintptr_t index) {
+        return (*pages_.at(index / PAGE_SIZE))[index % PAGE_SIZE];
+    }
+
+    slot* find_slot(std::uintptr_t index) {
+        if (index >= page_count_.load(std::memory_order_acquire) * PAGE_SIZE) {
+            return nullptr;
+        }
+
+        return &slot_at(index);
+    }
+
+    static std::uintptr_t index_of(handle_t handle) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return (reinterpret_cast<std::uintptr_t>(handle) & INDEX_MASK) - 1;
+    }
+
+    static std::uintptr_t generation_of(handle_t handle) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return reinterpret_cast<std::uintptr_t>(handle) >> INDEX_BITS;
+    }
+public:
+    handle_t insert(std::unique_ptr<Context> context) {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        std::size_t index = slot_count_;
+
+        if (!free_slots_.empty()) {
+            index = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            if (index == page_count_.load(std::memory_order_relaxed) * PAGE_SIZE) {
+                if (index / PAGE_SIZE == MAX_PAGES) {
+                    throw std::length_error("too many async handles");
+                }
+
+                pages_.at(index / PAGE_SIZE) = std::make_unique<page>();
+                page_count_.store(index / PAGE_SIZE + 1, std::memory_order_release);
+            }
+
+            ++slot_count_;
+        }
+
+        slot& target = slot_at(index);
+        const std::uintptr_t generation =
+            (target.generation.load(std::memory_order_relaxed) + 1)
+            & (std::numeric_limits<std::uintptr_t>::max() >> INDEX_BITS);
+
+        target.context = std::move(context);
+        target.generation.store(generation);
+        ++live_count_;
+
+        // NOLINTBEGIN(performance-no-int-to-ptr)
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return reinterpret_cast<handle_t>((generation << INDEX_BITS) | (index + 1));
+        // NOLINTEND(performance-no-int-to-ptr)
+    }
+
+    // Runs visitor on the context of a connected handle; returns false for a
+    // null, unknown or disconnected one.
+    template <typename Visitor>
+    bool visit(handle_t handle, const Visitor& visitor) {
+        slot* target = find_slot(index_of(handle));
+        if (target == nullptr) {
+            return false;
+        }
+
+        // Announces the reader before checking the generation; erase() bumps the
+        // generation before waiting for readers, so one of the two sees the other.
+        target->readers.fetch_add(1);
+        const bool connected = target->generation.load() == generation_of(handle);
+        if (connected) {
+            visitor(*target->context);
+        }
+
+        target->readers.fetch_sub(1);
+
+        return connected;
+    }
+
+    // Detaches the context of a handle once no receive is using it.
+    std::unique_ptr<Context> erase(handle_t handle) {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+        const std::uintptr_t index = index_of(handle);
+        slot* target = find_slot(index);
+
+        if (target == nullptr || target->generation.load() != generation_of(handle)) {
+            return nullptr;
+        }
+
+        target->generation.fetch_add(1);
+        while (target->readers.load() != 0) {
+            std::this_thread::yield();
+        }
+
+        free_slots_.push_back(index);
+        --live_count_;
+
+        return std::move(target->context);
+    }
+
+    [[nodiscard]] bool empty() {
+        const std::scoped_lock<std::mutex> lock(mutex_);
+
+        return live_count_ == 0;
+    }
+};
+
+} // namespace async
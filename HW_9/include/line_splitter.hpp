@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace async {
+
+// Splits received data into commands without copying complete lines. A line
+// cut by the end of one receive call is kept until a later call completes it.
+class line_splitter {
+    std::string carry_;
+public:
+    template <typename Handler>
+    void feed(std::string_view data, const Handler& on_line) {
+        // find() scans with memchr, which is vectorized by the C library.
+        auto end = data.find('\n');
+
+        if (!carry_.empty()) {
+            if (end == std::string_view::npos) {
+                carry_.append(data);
+
+                return;
+            }
+
+            carry_.append(data.substr(0, end));
+            on_line(std::string_view(carry_));
+            carry_.clear();
+            data.remove_prefix(end + 1);
+            end = data.find('\n');
+        }
+
+        while (end != std::string_view::npos) {
+            on_line(data.substr(0, end));
+            data.remove_prefix(end + 1);
+            end = data.find('\n');
+        }
+
+        carry_.assign(data);
+    }
+
+    // Hands over a trailing line that never got its newline.
+    template <typename Handler>
+    void finish(const Handler& on_line) {
+        if (!carry_.empty()) {
+            on_line(std::string_view(carry_));
+            carry_.clear();
+        }
+    }
+};
+
+} // namespace async
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <async.h>
+#include <line_splitter.hpp>
+
+namespace
+{
+    struct SplitResult
+    {
+        double seconds{0};
+        std::uint64_t commands{0};
+        std::uint64_t command_bytes{0};
+    };
+
+    // Commands of 1 to 32 printable characters with an occasional dynamic block,
+    // roughly what the command-line client feeds to async::receive.
+    std::string generate_input(const std::size_t size, const std::uint64_t seed)
+    {
+        constexpr std::size_t MAX_COMMAND_LENGTH = 32;
+        constexpr std::uint64_t BLOCK_PERIOD = 64;
+        std::mt19937_64 generator(seed);
+        std::string input;
+
+        input.reserve(size + MAX_COMMAND_LENGTH + 1);
+        while (input.size() < size)
+        {
+            const std::uint64_t value = generator();
+
+            if (value % BLOCK_PERIOD == 0)
+            {
+                input += "{\n";
+                continue;
+            }
+
+            if (value % BLOCK_PERIOD == 1)
+            {
+                input += "}\n";
+                continue;
+            }
+
+            const std::size_t length = 1 + ((value >> 8U) % MAX_COMMAND_LENGTH);
+            for (std::size_t index = 0; index < length; ++index)
+            {
+                input += static_cast<char>('a' + (generator() % 26));
+            }
+
+            input += '\n';
+        }
+
+        return input;
+    }
+
+    // What async::receive did before: copy every call into a string, wrap it in
+    // a stream and getline each command into another string.
+    SplitResult split_with_stream(const std::string_view input, const std::size_t chunk)
+    {
+        SplitResult result;
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t offset = 0; offset < input.size(); offset += chunk)
+        {
+            const std::string_view data = input.substr(offset, chunk);
+            const std::string copy(data);
+            std::istringstream stream(copy);
+            std::string command;
+
+            while (std::getline(stream, command))
+            {
+                if (!command.empty())
+                {
+                    ++result.commands;
+                    result.command_bytes += command.size();
+                }
+            }
+        }
+
+        result.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        return result;
+    }
+
+    SplitResult split_with_splitter(const std::string_view input, const std::size_t chunk)
+    {
+        SplitResult result;
+        async::line_splitter lines;
+        const auto count = [&result](std::string_view command) noexcept
+        {
+            if (!command.empty())
+            {
+                ++result.commands;
+                result.command_bytes += command.size();
+            }
+        };
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t offset = 0; offset < input.size(); offset += chunk)
+        {
+            lines.feed(input.substr(offset, chunk), count);
+        }
+
+        lines.finish(count);
+        result.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        return result;
+    }
+
+    void print_result(
+        const std::string_view name,
+        const std::size_t      chunk,
+        const std::size_t      input_size,
+        const SplitResult&     result)
+    {
+        constexpr int NAME_WIDTH = 10;
+        constexpr int NUMBER_WIDTH = 12;
+        constexpr double MIB = 1024.0 * 1024.0;
+
+        std::cout << std::left << std::setw(NAME_WIDTH) << name
+                  << std::right << std::setw(NUMBER_WIDTH) << chunk
+                  << std::setw(NUMBER_WIDTH) << std::fixed << std::setprecision(1)
+                  << static_cast<double>(input_size) / MIB / result.seconds
+                  << std::setw(NUMBER_WIDTH) << result.commands << '\n';
+    }
+
+    // Several clients feed large blocks at once; the output goes to /dev/null
+    // and to files in a scratch directory. Returns the seconds it took from
+    // the first receive until every block was written.
+    double measure_receive(
+        const std::size_t thread_count,
+        const std::size_t bulk,
+        const std::size_t blocks_per_thread,
+        const std::string& payload)
+    {
+        std::ofstream null_output("/dev/null");
+        auto* const console = std::cout.rdbuf(null_output.rdbuf());
+        auto *keep_alive = async::connect(bulk);
+        std::vector<std::thread> clients;
+        const std::size_t calls = blocks_per_thread * bulk
+            / static_cast<std::size_t>(std::count(payload.begin(), payload.end(), '\n'));
+        const auto start = std::chrono::steady_clock::now();
+
+        clients.reserve(thread_count);
+        for (std::size_t thread = 0; thread < thread_count; ++thread)
+        {
+            clients.emplace_back([bulk, calls, &payload]
+            {
+                auto *handle = async::connect(bulk);
+
+                for (std::size_t call = 0; call < calls; ++call)
+                {
+                    async::receive(handle, payload.data(), payload.size());
+                }
+
+                async::disconnect(handle);
+            });
+        }
+
+        for (auto& client : clients)
+        {
+            client.join();
+        }
+
+        async::disconnect(keep_alive);
+        std::cout.rdbuf(console);
+
+        return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+} // namespace
+
+int main()
+{
+    constexpr std::size_t INPUT_SIZE = 64 * 1024 * 1024;
+    constexpr std::uint64_t SEED = 1;
+    constexpr int NAME_WIDTH = 10;
+    constexpr int NUMBER_WIDTH = 12;
+    const std::string input = generate_input(INPUT_SIZE, SEED);
+
+    std::cout << "=== Performance Test: command splitting, " << input.size()
+              << " bytes ===\n";
+    std::cout << std::left << std::setw(NAME_WIDTH) << "path"
+              << std::right << std::setw(NUMBER_WIDTH) << "chunk"
+              << std::setw(NUMBER_WIDTH) << "MB/s"
+              << std::setw(NUMBER_WIDTH) << "commands" << '\n';
+
+    // Small chunks split most commands between calls, which the stream path
+    // turns into two commands and the splitter joins back together.
+    for (const std::size_t chunk : {std::size_t{64}, std::size_t{4096},
+        std::size_t{65536}, input.size()})
+    {
+        print_result("stream", chunk, input.size(), split_with_stream(input, chunk));
+        print_result("splitter", chunk, input.size(), split_with_splitter(input, chunk));
+    }
+
+    constexpr std::size_t THREAD_COUNT = 4;
+    constexpr std::size_t BULK = 1000;
+    constexpr std::size_t BLOCKS_PER_THREAD = 50;
+    constexpr std::size_t COMMANDS_PER_RECEIVE = 10;
+    constexpr double MIB = 1024.0 * 1024.0;
+    const std::filesystem::path initial_dir = std::filesystem::current_path();
+    const std::filesystem::path work_dir =
+        std::filesystem::temp_directory_path() / "async_performance_test";
+    std::string payload;
+
+    for (std::size_t index = 0; index < COMMANDS_PER_RECEIVE; ++index)
+    {
+        payload += "command" + std::to_string(index) + '\n';
+    }
+
+    std::filesystem::remove_all(work_dir);
+    std::filesystem::create_directories(work_dir);
+    std::filesystem::current_path(work_dir);
+
+    const double seconds = measure_receive(THREAD_COUNT, BULK, BLOCKS_PER_THREAD,
+        payload);
+
+    std::filesystem::current_path(initial_dir);
+    std::filesystem::remove_all(work_dir);
+
+    std::cout << "=== Performance Test: receive, " << THREAD_COUNT << " clients x "
+              << BLOCKS_PER_THREAD << " blocks of " << BULK << " commands ===\n"
+              << "MB/s " << std::fixed << std::setprecision(1)
+              << static_cast<double>(THREAD_COUNT * BLOCKS_PER_THREAD * BULK
+                  / COMMANDS_PER_RECEIVE * payload.size()) / MIB / seconds << '\n';
+
+    return 0;
+}
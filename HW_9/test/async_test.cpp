@@ -3,13 +3,17 @@
  || __cplusplus <=  202002L
 #include <charconv>
 #endif
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <set>
+#include <thread>
 
 #include <gtest/gtest.h>
 
 #include <absl_strings_match.hpp>
 #include <async.h>
+#include <async_config.h>
 #include <capture.hpp>
 
 namespace
@@ -194,3 +198,316 @@ TEST_F(HW9, MainFunctionality)
     ASSERT_TRUE(block4_found);
     ASSERT_TRUE(block5_found);
 }
+
+TEST_F(HW9, CommandSplitAcrossReceives)
+{
+    StdoutCapture::Begin();
+
+    const std::size_t bulk = 3;
+    auto *handle = async::connect(bulk);
+
+    async::receive(handle, "ab", 2);
+    async::receive(handle, "c\nd", 3);
+    async::receive(handle, "e", 1);
+    async::receive(handle, "f\n\nghi\n", 7);
+    async::receive(handle, "tail", 4);
+    async::disconnect(handle);
+
+    const std::string output = StdoutCapture::End();
+
+    ASSERT_TRUE(absl::StrContains(output, "bulk: abc, def, ghi\n"));
+    ASSERT_TRUE(absl::StrContains(output, "bulk: tail\n"));
+}
+
+TEST_F(HW9, MultiThreadedReceive)
+{
+    constexpr std::size_t THREAD_COUNT = 4;
+    constexpr std::size_t BULK = 1000;
+    constexpr std::size_t BLOCKS_PER_THREAD = 50;
+    constexpr std::size_t COMMANDS_PER_RECEIVE = 10;
+    constexpr std::size_t BLOCKS = THREAD_COUNT * BLOCKS_PER_THREAD;
+    constexpr std::string_view PREFIX = "bulk: ";
+
+    StdoutCapture::Begin();
+
+    std::vector<std::thread> clients;
+
+    clients.reserve(THREAD_COUNT);
+    for (std::size_t thread = 0; thread < THREAD_COUNT; ++thread)
+    {
+        clients.emplace_back([thread]
+        {
+            auto *handle = async::connect(BULK);
+            std::string payload;
+
+            // Every command is unique, so a block written twice shows up as
+            // a repeated command.
+            for (std::size_t call = 0;
+                 call < BLOCKS_PER_THREAD * BULK / COMMANDS_PER_RECEIVE; ++call)
+            {
+                payload.clear();
+                for (std::size_t index = 0; index < COMMANDS_PER_RECEIVE; ++index)
+                {
+                    payload += std::to_string(thread);
+                    payload += '_';
+                    payload += std::to_string(call * COMMANDS_PER_RECEIVE + index);
+                    payload += '\n';
+                }
+
+                async::receive(handle, payload.data(), payload.size());
+            }
+
+            async::disconnect(handle);
+        });
+    }
+
+    for (auto& client : clients)
+    {
+        client.join();
+    }
+
+    const std::string output = StdoutCapture::End();
+    std::size_t console_blocks = 0;
+
+    for (std::size_t position = output.find(PREFIX);
+         position != std::string::npos;
+         position = output.find(PREFIX, position + 1))
+    {
+        ++console_blocks;
+    }
+
+    std::set<std::string> commands;
+    std::size_t written_commands = 0;
+    const auto log_files =
+        get_log_files(get_start_time(), std::chrono::system_clock::now());
+
+    for (const auto &path : log_files)
+    {
+        const std::string text = read_file_content(path);
+        std::string_view content = text;
+
+        ASSERT_TRUE(content.starts_with(PREFIX));
+        content.remove_prefix(PREFIX.size());
+        while (!content.empty())
+        {
+            const std::size_t end = content.find_first_of(",\n");
+
+            commands.emplace(content.substr(0, end));
+            ++written_commands;
+            content.remove_prefix(std::min(content.size(), end + 2));
+        }
+    }
+
+    ASSERT_EQ(console_blocks, BLOCKS);
+    ASSERT_EQ(log_files.size(), BLOCKS);
+    ASSERT_EQ(written_commands, BLOCKS * BULK);
+    ASSERT_EQ(commands.size(), BLOCKS * BULK);
+}
+
+TEST_F(HW9, ConfigurableFileWriters)
+{
+    constexpr std::size_t WRITERS = 4;
+    constexpr std::size_t BLOCKS = 2 * WRITERS;
+
+    async::configure({WRITERS});
+    StdoutCapture::Begin();
+
+    auto *handle = async::connect(1);
+    for (std::size_t block = 0; block < BLOCKS; ++block)
+    {
+        const std::string command = std::to_string(block) + '\n';
+
+        async::receive(handle, command.data(), command.size());
+    }
+
+    async::disconnect(handle);
+    StdoutCapture::End();
+    async::configure({});
+
+    std::set<std::string> writer_ids;
+    const auto log_files =
+        get_log_files(get_start_time(), std::chrono::system_clock::now());
+    for (const auto &path : log_files)
+    {
+        // bulk<time>_<context>_<writer>_<counter>.log
+        const std::string filename = path.filename().string();
+        const std::size_t begin = filename.find('_', filename.find('_') + 1) + 1;
+
+        writer_ids.emplace(filename.substr(begin, filename.find('_', begin) - begin));
+    }
+
+    ASSERT_EQ(log_files.size(), BLOCKS);
+    ASSERT_EQ(writer_ids, (std::set<std::string>{"1", "2", "3", "4"}));
+}
+
+TEST_F(HW9, SegmentedFileOutput)
+{
+    constexpr std::size_t BLOCKS = 20;
+    // Neither a header nor a payload divides the segment size evenly, so some
+    // headers fit into a segment that has no room left for their payload.
+    constexpr std::size_t SEGMENT_BYTES = 97;
+    constexpr std::size_t LENGTH_PERIOD = 7;
+    const auto remove_segments = []
+    {
+        for (const auto &entry : std::filesystem::directory_iterator("."))
+        {
+            if (entry.path().filename().string().starts_with("bulk_segment_"))
+            {
+                std::filesystem::remove(entry.path());
+            }
+        }
+    };
+
+    remove_segments();
+
+    async::config settings;
+    settings.file_writers = 1;
+    settings.format = async::file_format::segments;
+    settings.segment_bytes = SEGMENT_BYTES;
+    async::configure(settings);
+    StdoutCapture::Begin();
+
+    auto *handle = async::connect(1);
+    for (std::size_t block = 0; block < BLOCKS; ++block)
+    {
+        std::string command(block % LENGTH_PERIOD, 'x');
+
+        command += std::to_string(block);
+        command += '\n';
+        async::receive(handle, command.data(), command.size());
+    }
+
+    async::disconnect(handle);
+    StdoutCapture::End();
+    async::configure({});
+
+    std::size_t segments = 0;
+    std::set<std::string> payloads;
+    for (const auto &entry : std::filesystem::directory_iterator("."))
+    {
+        if (!entry.path().filename().string().starts_with("bulk_segment_"))
+        {
+            continue;
+        }
+
+        // Every segment parses on its own: it starts with a header and ends
+        // right after the payload of its last block.
+        ++segments;
+        std::istringstream content(read_file_content(entry.path()));
+        std::string header;
+        while (std::getline(content, header))
+        {
+            // #<time> <context> <length>
+            ASSERT_TRUE(header.starts_with("#"));
+            const std::size_t length = std::stoul(header.substr(header.rfind(' ') + 1));
+            std::string payload(length, '\0');
+
+            content.read(payload.data(), static_cast<std::streamsize>(length));
+            ASSERT_EQ(content.gcount(), static_cast<std::streamsize>(length));
+            ASSERT_TRUE(payload.starts_with("bulk: "));
+            ASSERT_TRUE(payload.ends_with("\n"));
+            payloads.emplace(payload);
+        }
+    }
+
+    remove_segments();
+
+    ASSERT_GT(segments, 1);
+    ASSERT_EQ(payloads.size(), BLOCKS);
+    ASSERT_TRUE(payloads.contains("bulk: 0\n"));
+    ASSERT_TRUE(payloads.contains("bulk: xxxxx19\n"));
+    ASSERT_TRUE(
+        get_log_files(get_start_time(), std::chrono::system_clock::now()).empty());
+}
+
+TEST_F(HW9, MaxLatencyFlush)
+{
+    constexpr std::size_t BULK = 10;
+    constexpr std::chrono::milliseconds LATENCY{50};
+
+    async::config settings;
+    settings.max_latency = LATENCY;
+    async::configure(settings);
+    StdoutCapture::Begin();
+
+    auto *handle = async::connect(BULK);
+    async::receive(handle, "1\n2\n", 4);
+    std::this_thread::sleep_for(LATENCY * 6);
+    async::receive(handle, "3\n", 2);
+    async::disconnect(handle);
+
+    const std::string output = StdoutCapture::End();
+    async::configure({});
+
+    ASSERT_TRUE(absl::StrContains(output, "bulk: 1, 2\n"));
+    ASSERT_TRUE(absl::StrContains(output, "bulk: 3\n"));
+}
+
+TEST_F(HW9, DropOnOverflow)
+{
+    constexpr std::size_t BLOCKS = 1000;
+
+    async::config settings;
+    settings.file_writers = 1;
+    settings.high_watermark = 1;
+    settings.overflow = async::overflow_policy::drop;
+    async::configure(settings);
+    StdoutCapture::Begin();
+
+    const std::uint64_t dropped_before = async::dropped_blocks();
+    std::string commands;
+    for (std::size_t block = 0; block < BLOCKS; ++block)
+    {
+        commands += std::to_string(block) + '\n';
+    }
+
+    auto *handle = async::connect(1);
+    async::receive(handle, commands.data(), commands.size());
+    async::disconnect(handle);
+
+    const std::string output = StdoutCapture::End();
+    async::configure({});
+
+    const auto dropped = async::dropped_blocks() - dropped_before;
+    const auto printed = static_cast<std::size_t>(
+        std::count(output.begin(), output.end(), '\n'));
+
+    ASSERT_GT(dropped, 0U);
+    ASSERT_EQ(printed + dropped, BLOCKS);
+    ASSERT_EQ(get_log_files(get_start_time(), std::chrono::system_clock::now()).size(),
+        printed);
+    ASSERT_EQ(async::queued_blocks(), 0U);
+}
+
+TEST_F(HW9, SpillOnOverflow)
+{
+    constexpr std::size_t BLOCKS = 1000;
+
+    async::config settings;
+    settings.file_writers = 1;
+    settings.high_watermark = 4;
+    settings.low_watermark = 2;
+    settings.overflow = async::overflow_policy::spill;
+    async::configure(settings);
+    StdoutCapture::Begin();
+
+    const std::uint64_t dropped_before = async::dropped_blocks();
+    std::string commands;
+    std::string expected;
+    for (std::size_t block = 0; block < BLOCKS; ++block)
+    {
+        commands += std::to_string(block) + '\n';
+        expected += "bulk: " + std::to_string(block) + '\n';
+    }
+
+    auto *handle = async::connect(1);
+    async::receive(handle, commands.data(), commands.size());
+    async::disconnect(handle);
+
+    const std::string output = StdoutCapture::End();
+    async::configure({});
+
+    ASSERT_EQ(output, expected);
+    ASSERT_EQ(async::dropped_blocks(), dropped_before);
+    ASSERT_FALSE(std::filesystem::exists("bulk_spill.tmp"));
+}